@@ -0,0 +1,73 @@
+/**
+  *	ADC scan test (STM32F030)
+  *	PA1 (ADC_IN1), PA4 (ADC_IN4) and temperature sensor are sampled at 1 kHz by DMA.
+  *	Filtered values (14 bit) are sent over USART1 (PA9, PA10) every 500 ms, LED toggles on each block.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds and buttons
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+#define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
+
+#define ANALOG_CHANNELS	3	// ADC_Channel_1, ADC_Channel_4, ADC_Channel_16
+
+void GPIO_Setup( void )
+{
+	//STM32F030 discovery onboard leds
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	gpio_pinSetup(GPIOC, D2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	
+	//ANALOG INPUTS
+	gpio_pinSetup(GPIOA, GPIO_Pin_1, GPIO_Mode_AN, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_50MHz);
+	gpio_pinSetup(GPIOA, GPIO_Pin_4, GPIO_Mode_AN, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_50MHz);
+}
+
+// DMA interrupt: 16 samples of each channel (16 ms at 1 kHz)
+void adc_block_handler(const adc_block_t* block)
+{
+	if(block->half){
+		reg_gpioSet(GPIOC, D2);
+	}
+	else{
+		reg_gpioReset(GPIOC, D2);
+	}
+}
+
+int main(void)
+{	
+	uint32_t print_time = 0;
+	adc_channel_t channel;
+	uint8_t i;
+	
+	GPIO_Setup();
+	systick_millis_init();
+	UART_Init();	// PA9, PA10
+	
+	adc_scanInit(ADC_Channel_1 | ADC_Channel_4 | ADC_Channel_16, 1000);
+	adc_scanCallback(adc_block_handler);
+	adc_scanStart();
+	
+	while(1){  
+		if((millis() - print_time) >= 500){
+			print_time = millis();
+			gpio_toggleBit(GPIOC, D1);
+			
+			printNumber(adc_scanTimestamp(), DEC);
+			printString(" ms:");
+			for(i = 0; i < ANALOG_CHANNELS; i++){
+				adc_scanRead(i, &channel);
+				printString(" ");
+				printNumber(channel.filtered, DEC);
+				printString(" (avg ");
+				printNumber(channel.average, DEC);
+				printString(")");
+			}
+			printLn();
+		}
+  }
+}
+  
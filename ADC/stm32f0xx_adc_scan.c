@@ -0,0 +1,230 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: ADC scan with DMA and fixed-point filters #####
+																				c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_adc_scan.h"
+
+#define ADC_BLOCK_LENGTH	(ADC_BLOCK_SAMPLES * ADC_MAX_CHANNELS)	// max samples in half of DMA buffer
+
+static uint16_t adc_dma_buffer[2 * ADC_BLOCK_LENGTH];
+static uint8_t adc_channel_count = 0;
+
+// filters: written only in DMA interrupt
+static adc_channel_t adc_channels[ADC_MAX_CHANNELS];
+static uint16_t adc_average_history[ADC_MAX_CHANNELS][1 << ADC_AVERAGE_SHIFT];
+static uint32_t adc_average_sum[ADC_MAX_CHANNELS];
+static uint8_t adc_average_index = 0;
+static uint32_t adc_iir_state[ADC_MAX_CHANNELS];	// filtered << ADC_IIR_SHIFT: no truncation error accumulates
+static uint8_t adc_filters_ready = 0;							// first block initializes filters
+
+static adc_block_t adc_block;
+static adc_callback_t adc_callback = 0;
+
+/* Preset filters to first value: no ramp from 0 */
+static void _adc_filters_preset(uint8_t index, uint16_t value) {
+	uint8_t i;
+
+	for (i = 0; i < (1 << ADC_AVERAGE_SHIFT); i++) {
+		adc_average_history[index][i] = value;
+	}
+	adc_average_sum[index] = (uint32_t)value << ADC_AVERAGE_SHIFT;
+	adc_iir_state[index] = (uint32_t)value << ADC_IIR_SHIFT;
+}
+
+/* Called from DMA interrupt: block of ADC_BLOCK_SAMPLES samples of each channel */
+static void _adc_process(const uint16_t* samples, uint8_t half) {
+	uint32_t sum[ADC_MAX_CHANNELS];
+	const uint16_t* sample = samples;
+	uint16_t value;
+	uint8_t index;
+	uint8_t i;
+
+	for (index = 0; index < adc_channel_count; index++) {
+		sum[index] = 0;
+	}
+	for (i = 0; i < ADC_BLOCK_SAMPLES; i++) {
+		for (index = 0; index < adc_channel_count; index++) {
+			sum[index] += *sample++;
+		}
+	}
+
+	for (index = 0; index < adc_channel_count; index++) {
+		// decimation: 4^n samples, n bits more
+		value = sum[index] >> ADC_OVERSAMPLE_BITS;
+		if (!adc_filters_ready) {
+			_adc_filters_preset(index, value);
+		}
+		adc_channels[index].raw = value;
+
+		adc_average_sum[index] -= adc_average_history[index][adc_average_index];
+		adc_average_history[index][adc_average_index] = value;
+		adc_average_sum[index] += value;
+		adc_channels[index].average = adc_average_sum[index] >> ADC_AVERAGE_SHIFT;
+
+		adc_iir_state[index] += value - (adc_iir_state[index] >> ADC_IIR_SHIFT);
+		adc_channels[index].filtered = adc_iir_state[index] >> ADC_IIR_SHIFT;
+	}
+	adc_average_index = (adc_average_index + 1) & ((1 << ADC_AVERAGE_SHIFT) - 1);
+	adc_filters_ready = 1;
+
+	adc_block.timestamp = millis();
+	adc_block.sequence++;
+	adc_block.samples = samples;
+	adc_block.half = half;
+	if (adc_callback) {
+		adc_callback(&adc_block);
+	}
+}
+
+void adc_scanInit(uint32_t channels, uint32_t sample_rate) {
+	ADC_InitTypeDef adc;
+	DMA_InitTypeDef dma;
+	TIM_TimeBaseInitTypeDef adc_timer;
+	NVIC_InitTypeDef dma_int;
+	RCC_ClocksTypeDef system_freq;
+	uint32_t mask;
+	uint32_t max_rate;
+	uint16_t block_length;
+
+	// channels are converted in ascending order: count them, channels above ADC_MAX_CHANNELS lowest are ignored
+	adc_channel_count = 0;
+	mask = 0;
+	while (channels && (adc_channel_count < ADC_MAX_CHANNELS)) {
+		mask |= channels & (~channels + 1);	// lowest channel
+		channels &= channels - 1;
+		adc_channel_count++;
+	}
+	channels = mask;
+	block_length = ADC_BLOCK_SAMPLES * adc_channel_count;
+	
+	// scan of all channels must finish before next trigger, timer period must fit 16 bits
+	max_rate = ADC_SCAN_CLOCK / (ADC_SCAN_CONV_CYCLES * (adc_channel_count ? adc_channel_count : 1));
+	if (sample_rate > max_rate) {
+		sample_rate = max_rate;
+	}
+	if (sample_rate < ADC_SCAN_MIN_RATE) {
+		sample_rate = ADC_SCAN_MIN_RATE;
+	}
+	adc_filters_ready = 0;
+	adc_average_index = 0;
+	adc_block.sequence = 0;
+	adc_block.channels = adc_channels;
+	adc_block.channel_count = adc_channel_count;
+
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	RCC_APB1PeriphClockCmd(ADC_SCAN_TIM_RCC, ENABLE);
+
+	// ADC: one scan of all channels on each trigger, ADC clock: HSI14 (reset value)
+	ADC_DeInit(ADC1);
+	ADC_StructInit(&adc);
+	adc.ADC_Resolution = ADC_Resolution_12b;
+	adc.ADC_ContinuousConvMode = DISABLE;
+	adc.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_Rising;
+	adc.ADC_ExternalTrigConv = ADC_SCAN_TRIGGER;
+	adc.ADC_DataAlign = ADC_DataAlign_Right;
+	adc.ADC_ScanDirection = ADC_ScanDirection_Upward;
+	ADC_Init(ADC1, &adc);
+	ADC_ChannelConfig(ADC1, channels, ADC_SCAN_SAMPLE_TIME);
+	if (channels & ADC_Channel_16) {
+		ADC_TempSensorCmd(ENABLE);
+	}
+	if (channels & ADC_Channel_17) {
+		ADC_VrefintCmd(ENABLE);
+	}
+	ADC_OverrunModeCmd(ADC1, ENABLE);	// DMA late: sample is overwritten, scan order is kept
+	ADC_GetCalibrationFactor(ADC1);		// ADC must be disabled
+	ADC_DMARequestModeConfig(ADC1, ADC_DMAMode_Circular);
+	ADC_DMACmd(ADC1, ENABLE);
+
+	// DMA1 channel 1: ADC1 -> buffer, two blocks
+	DMA_DeInit(DMA1_Channel1);
+	DMA_StructInit(&dma);
+	dma.DMA_PeripheralBaseAddr = (uint32_t)&ADC1->DR;
+	dma.DMA_MemoryBaseAddr = (uint32_t)adc_dma_buffer;
+	dma.DMA_DIR = DMA_DIR_PeripheralSRC;
+	dma.DMA_BufferSize = 2 * block_length;
+	dma.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	dma.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+	dma.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+	dma.DMA_Mode = DMA_Mode_Circular;
+	dma.DMA_Priority = DMA_Priority_High;
+	dma.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(DMA1_Channel1, &dma);
+
+	dma_int.NVIC_IRQChannel = DMA1_Channel1_IRQn;
+	dma_int.NVIC_IRQChannelPriority = 2;	// block must be processed before DMA overwrites it
+	dma_int.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&dma_int);
+	reg_dmaClear(DMA1_IT_GL1);
+	DMA_ITConfig(DMA1_Channel1, DMA_IT_HT | DMA_IT_TC, ENABLE);
+	DMA_Cmd(DMA1_Channel1, ENABLE);
+
+	// ADC_SCAN_TIM: 1us resolution, TRGO on update
+	RCC_GetClocksFreq(&system_freq);	//get system clocks
+	adc_timer.TIM_Prescaler = (system_freq.PCLK_Frequency / 1000000) - 1;	// 1us timer increment
+	adc_timer.TIM_CounterMode = TIM_CounterMode_Up;
+	adc_timer.TIM_Period = ((1000000 + sample_rate - 1) / sample_rate) - 1;	// rounded up: rate <= sample_rate
+	adc_timer.TIM_ClockDivision = TIM_CKD_DIV1;
+	adc_timer.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(ADC_SCAN_TIM, &adc_timer);
+	TIM_SelectOutputTrigger(ADC_SCAN_TIM, TIM_TRGOSource_Update);
+	TIM_Cmd(ADC_SCAN_TIM, DISABLE);
+
+	ADC_Cmd(ADC1, ENABLE);
+	while (ADC_GetFlagStatus(ADC1, ADC_FLAG_ADRDY) == RESET);
+}
+
+void adc_scanStart(void) {
+	ADC_StartOfConversion(ADC1);	// conversions start on triggers
+	reg_timSetCounter(ADC_SCAN_TIM, 0);
+	reg_timStart(ADC_SCAN_TIM);
+}
+
+void adc_scanStop(void) {
+	reg_timStop(ADC_SCAN_TIM);
+	ADC_StopOfConversion(ADC1);
+}
+
+void adc_scanCallback(adc_callback_t callback) {
+	adc_callback = callback;
+}
+
+void adc_scanRead(uint8_t index, adc_channel_t* channel) {
+	if (index >= adc_channel_count) {
+		channel->raw = 0;
+		channel->average = 0;
+		channel->filtered = 0;
+		return;
+	}
+	atomic_enter();
+	*channel = adc_channels[index];
+	atomic_exit();
+}
+
+uint32_t adc_scanTimestamp(void) {
+	return adc_block.timestamp;
+}
+
+void adc_scanClockUpdate(const RCC_ClocksTypeDef* clocks) {
+	TIM_PrescalerConfig(ADC_SCAN_TIM, (clocks->PCLK_Frequency / 1000000) - 1, TIM_PSCReloadMode_Update);
+}
+
+/* Half transfer: first block complete, transfer complete: second block complete */
+void DMA1_Channel1_IRQHandler(void) {
+	if (reg_dmaPending(DMA1_IT_HT1)) {
+		reg_dmaClear(DMA1_IT_HT1);
+		_adc_process(&adc_dma_buffer[0], 0);
+	}
+	if (reg_dmaPending(DMA1_IT_TC1)) {
+		reg_dmaClear(DMA1_IT_TC1);
+		_adc_process(&adc_dma_buffer[ADC_BLOCK_SAMPLES * adc_channel_count], 1);
+	}
+}
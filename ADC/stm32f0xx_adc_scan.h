@@ -0,0 +1,111 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: ADC scan with DMA and fixed-point filters #####
+																			header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * ADC_SCAN_TIM update event triggers conversion of all selected channels (sample_rate for each channel).
+ * DMA writes samples to circular buffer, CPU is interrupted only at half and full transfer:
+ * each half is a block of ADC_BLOCK_SAMPLES samples of each channel, processed at once:
+ *	- oversampling and decimation: sum of 4^ADC_OVERSAMPLE_BITS samples >> ADC_OVERSAMPLE_BITS
+ *		= ADC_RESOLUTION bits (noise must be at least 1 LSB for real resolution gain)
+ *	- moving average over 2^ADC_AVERAGE_SHIFT blocks
+ *	- IIR (exponential) filter: y += (x - y) / 2^ADC_IIR_SHIFT
+ * No divisions (Cortex-M0): power of 2 lengths, shifts only. Blocks are timestamped with millis().
+ *
+ *	gpio_pinSetup(GPIOA, GPIO_Pin_1, GPIO_Mode_AN, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_50MHz);
+ *	adc_scanInit(ADC_Channel_1 | ADC_Channel_4, 1000);	// index 0: channel 1, index 1: channel 4
+ *	adc_scanStart();
+ *	adc_scanRead(1, &value);
+ *
+ * Channels are converted in ascending channel number order, index of channel is its position in this order.
+ * ADC runs from HSI14 (not affected by system clock changes), ADC_SCAN_TIM from PCLK: register
+ * adc_scanClockUpdate() with clock_register() if system clock is switched.
+ * Max sample_rate: ADC_SCAN_SAMPLE_TIME + 12.5 ADC cycles (14 MHz) per channel, ~200 kHz for 1 channel, ~25 kHz for 8.
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_ADC_SCAN_H
+#define __STM32F0XX_ADC_SCAN_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "stm32f0xx_adc.h"
+#include "stm32f0xx_dma.h"
+#include "stm32f0xx_rcc.h"
+#include "stm32f0xx_tim.h"
+#include "stm32f0xx_misc.h"
+#include "stm32f0xx_reg.h"
+#include "stm32f0xx_atomic.h"
+#include "systick_millis.h"
+
+#define ADC_SCAN_TIM					TIM3		// APB1 timer, TRGO = update event (TIM3 can't be used as STEPPER pwm_timer)
+#define ADC_SCAN_TIM_RCC			RCC_APB1Periph_TIM3
+#define ADC_SCAN_TRIGGER			ADC_ExternalTrigConv_T3_TRGO
+#define ADC_SCAN_SAMPLE_TIME	ADC_SampleTime_55_5Cycles
+#define ADC_SCAN_CONV_CYCLES	68			// ADC_SCAN_SAMPLE_TIME + 12.5: ADC clock cycles per channel
+#define ADC_SCAN_CLOCK				14000000	// HSI14
+#define ADC_SCAN_MIN_RATE			16			// 16 bit ADC_SCAN_TIM period with 1us resolution
+
+#define ADC_MAX_CHANNELS		8
+#define ADC_OVERSAMPLE_BITS	2		// extra resolution bits
+#define ADC_BLOCK_SAMPLES		(1 << (2 * ADC_OVERSAMPLE_BITS))	// samples of each channel in block
+#define ADC_RESOLUTION			(12 + ADC_OVERSAMPLE_BITS)				// bits of all values in adc_channel_t
+#define ADC_AVERAGE_SHIFT		3		// moving average over 2^ADC_AVERAGE_SHIFT blocks
+#define ADC_IIR_SHIFT				4		// IIR time constant: ~2^ADC_IIR_SHIFT blocks
+
+/* Values of one channel, ADC_RESOLUTION bits */
+typedef struct {
+	uint16_t raw;				// oversampled value of last block
+	uint16_t average;		// moving average
+	uint16_t filtered;	// IIR filter output
+} adc_channel_t;
+
+/* Processed block, passed to callback */
+typedef struct {
+	uint32_t timestamp;							// millis() when block was completed
+	uint32_t sequence;							// block number: gaps = lost blocks (processing too slow)
+	const uint16_t* samples;				// raw 12 bit samples, interleaved: [sample * channel_count + index]
+	const adc_channel_t* channels;	// filter outputs after this block
+	uint8_t channel_count;
+	uint8_t half;										// 0: first half of DMA buffer, 1: second half
+} adc_block_t;
+
+/* Called from DMA interrupt after each block. Samples are valid until next half/full transfer callback. */
+typedef void (*adc_callback_t)(const adc_block_t* block);
+
+/*
+	Initialize ADC, DMA and ADC_SCAN_TIM. Pins must be set up as GPIO_Mode_AN.
+	channels: ADC_Channel_x mask, up to ADC_MAX_CHANNELS (ADC_Channel_16: temperature sensor,
+		ADC_Channel_17: VREFINT are enabled)
+	sample_rate: conversions of each channel per second, clamped to 
+		ADC_SCAN_MIN_RATE - ADC_SCAN_CLOCK / (ADC_SCAN_CONV_CYCLES * channel count)
+*/
+void adc_scanInit(uint32_t channels, uint32_t sample_rate);
+
+void adc_scanStart(void);
+void adc_scanStop(void);
+
+/* Callback for each block, 0: none */
+void adc_scanCallback(adc_callback_t callback);
+
+/* Consistent copy of channel values (index: position in ascending channel order), all 0 if index is not scanned */
+void adc_scanRead(uint8_t index, adc_channel_t* channel);
+
+/* millis() of last processed block */
+uint32_t adc_scanTimestamp(void);
+
+/* System clock changed: recalculate ADC_SCAN_TIM prescaler (register with clock_register()) */
+void adc_scanClockUpdate(const RCC_ClocksTypeDef* clocks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_ADC_SCAN_H */
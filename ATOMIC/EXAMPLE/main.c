@@ -0,0 +1,87 @@
+/**
+  *	Interrupt safe shared state test (STM32F030)
+  *	Button (PA0) interrupt: press time into SPSC ring, event flag. Main loop prints them (USART1: PA9, PA10)
+  *	and maximum time with interrupts disabled (ATOMIC_MEASURE defined in stm32f0xx_atomic.h).
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds and buttons
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+#define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
+#define B1 GPIO_Pin_0	//GPIOA, PA0
+
+#define PRESS_RING_SIZE	8		// power of 2
+
+static uint32_t press_time[PRESS_RING_SIZE];
+static atomic_ring_t press_ring = {0, 0, PRESS_RING_SIZE - 1};	// interrupt: producer, main: consumer
+static atomic_flag_t press_lost = 0;		// ring was full
+static volatile uint32_t press_count = 0;	// incremented in interrupt, cleared in main
+
+void GPIO_Setup( void )
+{
+	//STM32F030 discovery onboard leds and button
+	//LEDS
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	gpio_pinSetup(GPIOC, D2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		
+	//BUTTON 
+	gpio_pinSetup(GPIOA, B1, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_interrupt(GPIOA, B1, EXTI_Trigger_Rising, 1);
+}
+
+int main(void)
+{	
+	uint32_t count;
+	
+	GPIO_Setup();
+	systick_millis_init();
+	UART_Init();	// PA9, PA10
+	
+	while(1){  
+		while(!atomic_ringEmpty(&press_ring)){
+			printString("Button pressed at ");
+			printNumberLn(press_time[atomic_ringTail(&press_ring)], DEC);
+			atomic_ringPop(&press_ring);
+		}
+		if(atomic_flagTake(&press_lost)){
+			printStringLn("Presses lost: ring full");
+		}
+		
+		// read and clear counter: read-modify-write of variable written in interrupt
+		atomic_enter();
+		count = press_count;
+		press_count = 0;
+		atomic_exit();
+		if(count){
+			printString("Presses: ");
+			printNumberLn(count, DEC);
+		}
+		
+		#ifdef ATOMIC_MEASURE
+			printString("Max. interrupts disabled [cycles]: ");
+			printNumberLn(atomic_maxHold(), DEC);
+		#endif
+		
+		gpio_toggleBit(GPIOC, D1);
+		delay(1000);
+  }
+}
+
+// PA0 (button B1) interrupt handler
+void EXTI0_1_IRQHandler(void){
+	if(reg_extiPending(EXTI_Line0))  {
+		reg_extiClear(EXTI_Line0);
+		press_count++;	// main loop can't interrupt this
+		if(atomic_ringFull(&press_ring)){
+			atomic_flagSet(&press_lost);
+		}
+		else{
+			press_time[atomic_ringHead(&press_ring)] = millis();
+			atomic_ringPush(&press_ring);
+		}
+	}
+}
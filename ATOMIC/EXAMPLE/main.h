@@ -0,0 +1,15 @@
+  
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+
+#include <stm32f0xx_gpio_init.h>
+#include <stm32f0xx_atomic.h>
+#include <systick_millis.h>
+#include <stm32f030xx_uart_print.h>
+
+
+#endif /* __MAIN_H */
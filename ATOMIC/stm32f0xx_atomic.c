@@ -0,0 +1,54 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: interrupt safe shared state #####
+																			c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_atomic.h"
+
+volatile uint8_t _atomic_nesting = 0;	// atomic_enter() depth
+uint32_t _atomic_primask;							// PRIMASK before outermost atomic_enter()
+
+#ifdef ATOMIC_MEASURE
+uint32_t _atomic_start;								// SysTick->VAL at outermost atomic_enter()
+static uint32_t _atomic_max_hold = 0;
+
+/*
+	Called with interrupts disabled, at outermost atomic_exit(). SysTick counts down from LOAD to 0:
+	longer hold times than one SysTick period are measured modulo period.
+*/
+void _atomic_measure(void) {
+	uint32_t now = SysTick->VAL;
+	uint32_t hold;
+
+	if (now <= _atomic_start) {
+		hold = _atomic_start - now;
+	}
+	else {
+		hold = _atomic_start + SysTick->LOAD + 1 - now;
+	}
+	if (hold > _atomic_max_hold) {
+		_atomic_max_hold = hold;
+	}
+}
+#endif
+
+uint32_t atomic_maxHold(void) {
+	#ifdef ATOMIC_MEASURE
+		return _atomic_max_hold;
+	#else
+		return 0;
+	#endif
+}
+
+void atomic_resetMaxHold(void) {
+	#ifdef ATOMIC_MEASURE
+		atomic_enter();
+		_atomic_max_hold = 0;
+		atomic_exit();
+	#endif
+}
@@ -0,0 +1,211 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: interrupt safe shared state #####
+																		header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * State shared between interrupt routines and main loop:
+ *	- critical sections: interrupts disabled (PRIMASK), nestable, maximum hold time is measured
+ *	- SPSC ring: indexes of a single producer / single consumer queue, no locking needed
+ *	- flags: set in one context, taken (test and clear) in the other
+ *
+ * Cortex-M0: aligned 8, 16 and 32 bit loads and stores are atomic, read-modify-write (x++, x |= y) is not.
+ * Variables shared with interrupt routines must be volatile, otherwise compiler can keep them in registers
+ * (e.g. while(flag == 0); becomes endless loop with -O1 or higher).
+ *
+ *	atomic_enter();
+ *		shared_counter += n;	// read-modify-write of variable also written in interrupt routine
+ *	atomic_exit();
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_ATOMIC_H
+#define __STM32F0XX_ATOMIC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+
+/* 
+	Measure maximum time with interrupts disabled (SysTick cycles, systick_millis_init() must be called).
+	Debug option: adds SysTick reads and a function call to every critical section (queues, events, log).
+*/
+//#define ATOMIC_MEASURE
+
+/* Compiler and memory barrier: stores before barrier are done before stores after it */
+#define ATOMIC_BARRIER()	__DMB()
+
+/****************************************************************************************/
+/* CRITICAL SECTIONS */
+/****************************************************************************************/
+/* private */
+extern volatile uint8_t _atomic_nesting;
+extern uint32_t _atomic_primask;
+#ifdef ATOMIC_MEASURE
+	extern uint32_t _atomic_start;
+	void _atomic_measure(void);
+#endif
+
+/*
+	Disable interrupts. Nestable: interrupts are enabled by outermost atomic_exit(),
+	only if they were enabled before outermost atomic_enter(). Can be used in interrupt routines.
+*/
+static inline void atomic_enter(void) {
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if (_atomic_nesting++ == 0) {
+		_atomic_primask = primask;
+		#ifdef ATOMIC_MEASURE
+			_atomic_start = SysTick->VAL;
+		#endif
+	}
+}
+
+static inline void atomic_exit(void) {
+	if (--_atomic_nesting == 0) {
+		#ifdef ATOMIC_MEASURE
+			_atomic_measure();
+		#endif
+		if (_atomic_primask == 0) {
+			__enable_irq();
+		}
+	}
+}
+
+/* Maximum time with interrupts disabled by atomic_enter() [SysTick cycles = core clock cycles], 0 without ATOMIC_MEASURE */
+uint32_t atomic_maxHold(void);
+void atomic_resetMaxHold(void);
+
+/****************************************************************************************/
+/* SPSC RING */
+/****************************************************************************************/
+/*
+	Indexes of ring buffer with power of 2 size (one slot is always free). Buffer of any type is owned by user.
+	Producer: write buffer[atomic_ringHead(&ring)], then atomic_ringPush(&ring).
+	Consumer: read buffer[atomic_ringTail(&ring)], then atomic_ringPop(&ring).
+	Producer writes only head, consumer writes only tail: one side can be interrupt routine, no locking.
+*/
+typedef struct {
+	volatile uint16_t head;	// next free slot, written by producer
+	volatile uint16_t tail;	// oldest slot, written by consumer
+	uint16_t mask;					// size - 1
+} atomic_ring_t;
+
+static inline void atomic_ringInit(atomic_ring_t* ring, uint16_t size) {
+	ring->head = 0;
+	ring->tail = 0;
+	ring->mask = size - 1;
+}
+
+static inline uint8_t atomic_ringEmpty(const atomic_ring_t* ring) {
+	return (ring->head == ring->tail);
+}
+
+static inline uint8_t atomic_ringFull(const atomic_ring_t* ring) {
+	return (((ring->head + 1) & ring->mask) == ring->tail);
+}
+
+/* Number of used slots */
+static inline uint16_t atomic_ringCount(const atomic_ring_t* ring) {
+	return ((ring->head - ring->tail) & ring->mask);
+}
+
+/* Producer: slot to write (check atomic_ringFull() first) */
+static inline uint16_t atomic_ringHead(const atomic_ring_t* ring) {
+	return ring->head;
+}
+
+/* Producer: slot is written, make it visible to consumer */
+static inline void atomic_ringPush(atomic_ring_t* ring) {
+	ATOMIC_BARRIER();
+	ring->head = (ring->head + 1) & ring->mask;
+}
+
+/* Consumer: slot to read (check atomic_ringEmpty() first) */
+static inline uint16_t atomic_ringTail(const atomic_ring_t* ring) {
+	return ring->tail;
+}
+
+/* Consumer: slot is read, give it back to producer */
+static inline void atomic_ringPop(atomic_ring_t* ring) {
+	ATOMIC_BARRIER();
+	ring->tail = (ring->tail + 1) & ring->mask;
+}
+
+/* Number of free slots */
+static inline uint16_t atomic_ringFree(const atomic_ring_t* ring) {
+	return ring->mask - atomic_ringCount(ring);
+}
+
+/* Producer: count slots from atomic_ringHead() on are written (check atomic_ringFree() first) */
+static inline void atomic_ringPushN(atomic_ring_t* ring, uint16_t count) {
+	ATOMIC_BARRIER();
+	ring->head = (ring->head + count) & ring->mask;
+}
+
+/* Consumer: count slots from atomic_ringTail() on are read */
+static inline void atomic_ringPopN(atomic_ring_t* ring, uint16_t count) {
+	ATOMIC_BARRIER();
+	ring->tail = (ring->tail + count) & ring->mask;
+}
+
+/****************************************************************************************/
+/* FLAGS */
+/****************************************************************************************/
+/* Event flag: set by one context, taken by the other. Events set before flag is taken are merged. */
+typedef volatile uint8_t atomic_flag_t;
+
+static inline void atomic_flagSet(atomic_flag_t* flag) {
+	ATOMIC_BARRIER();	// data written before event is visible
+	*flag = 1;
+}
+
+static inline void atomic_flagClear(atomic_flag_t* flag) {
+	*flag = 0;
+}
+
+/* Returns 1 and clears flag if it was set. Only the context that takes the flag may clear it. */
+static inline uint8_t atomic_flagTake(atomic_flag_t* flag) {
+	if (*flag == 0) {
+		return 0;
+	}
+	*flag = 0;
+	ATOMIC_BARRIER();
+	return 1;
+}
+
+/* Bit mask written from both contexts: read-modify-write in critical section */
+static inline void atomic_setBits(volatile uint32_t* bits, uint32_t mask) {
+	atomic_enter();
+	*bits |= mask;
+	atomic_exit();
+}
+
+static inline void atomic_clearBits(volatile uint32_t* bits, uint32_t mask) {
+	atomic_enter();
+	*bits &= ~mask;
+	atomic_exit();
+}
+
+/* Returns bits of mask that were set and clears them */
+static inline uint32_t atomic_takeBits(volatile uint32_t* bits, uint32_t mask) {
+	uint32_t taken;
+
+	atomic_enter();
+	taken = *bits & mask;
+	*bits &= ~taken;
+	atomic_exit();
+	return taken;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_ATOMIC_H */
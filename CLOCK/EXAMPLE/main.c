@@ -0,0 +1,78 @@
+/**
+  *	Clock manager test (STM32F030)
+  *	System clock: 48 MHz (PLL). Button (PA0) switches between 48 MHz and 8 MHz.
+  *	LED blink rate (millis()), delay_us() pulse on PC8 and USART1 (PA9, PA10) output must not change.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds and buttons
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+#define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
+#define B1 GPIO_Pin_0	//GPIOA, PA0
+
+atomic_flag_t button_flag = 0;
+
+void GPIO_Setup( void )
+{
+	//STM32F030 discovery onboard leds and button
+	//LEDS
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	gpio_pinSetup(GPIOC, D2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		
+	//BUTTON 
+	gpio_pinSetup(GPIOA, B1, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_interrupt(GPIOA, B1, EXTI_Trigger_Rising, 1);
+}
+
+int main(void)
+{	
+	uint32_t blink_time = 0;
+	
+	if(clock_init(CLOCK_48MHZ) == ERROR){
+		// CLOCK_USE_HSE: crystal didn't start, running from HSI
+	}
+	GPIO_Setup();
+	systick_millis_init();
+	delay_us_init();
+	UART_Init();	// PA9, PA10
+	
+	clock_register(systick_millis_clockUpdate);
+	clock_register(delay_us_clockUpdate);
+	clock_register(UART_ClockUpdate);
+	
+	while(1){  
+		if(atomic_flagTake(&button_flag)){
+			delay(1);	// last printed byte is sent (0.5 ms at 19200)
+			if(clock_getFrequency() == CLOCK_48MHZ){
+				clock_setFrequency(CLOCK_8MHZ);
+			}
+			else{
+				clock_setFrequency(CLOCK_48MHZ);
+			}
+			printString("System clock: ");
+			printNumber(SystemCoreClock, DEC);
+			printStringLn(" Hz");
+		}
+		if((millis() - blink_time) >= 500){
+			blink_time = millis();
+			gpio_toggleBit(GPIOC, D1);
+			// 100 us pulse
+			reg_gpioSet(GPIOC, D2);
+			delay_us(100);
+			reg_gpioReset(GPIOC, D2);
+		}
+  }
+}
+
+// PA0 (button B1) interrupt handler
+void EXTI0_1_IRQHandler(void){
+	if(reg_extiPending(EXTI_Line0))  {
+		reg_extiClear(EXTI_Line0);
+		atomic_flagSet(&button_flag);
+	}
+}
+  
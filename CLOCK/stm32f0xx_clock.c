@@ -0,0 +1,148 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: system clock configuration #####
+																				c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_clock.h"
+
+#define CLOCK_SWS_HSI		0x00	// RCC_GetSYSCLKSource() values
+#define CLOCK_SWS_HSE		0x04
+#define CLOCK_SWS_PLL		0x08
+#define CLOCK_PLL_TIMEOUT	0x5000
+
+static clock_callback_t clock_callbacks[CLOCK_MAX_CALLBACKS];
+static uint8_t clock_callback_count = 0;
+static clock_freq_t clock_freq = CLOCK_8MHZ;
+static uint8_t clock_hse = 0;	// HSE is running
+
+/* Switch SYSCLK and wait until switch is done */
+static void _clock_switch(uint32_t source, uint8_t status) {
+	RCC_SYSCLKConfig(source);
+	while (RCC_GetSYSCLKSource() != status);
+}
+
+/* 8 MHz source, without PLL */
+static void _clock_switch_direct(void) {
+	if (clock_hse) {
+		_clock_switch(RCC_SYSCLKSource_HSE, CLOCK_SWS_HSE);
+	}
+	else {
+		_clock_switch(RCC_SYSCLKSource_HSI, CLOCK_SWS_HSI);
+	}
+}
+
+/* Configure and start PLL (must be off), wait for lock */
+static ErrorStatus _clock_pll_start(void) {
+	uint32_t timeout = CLOCK_PLL_TIMEOUT;
+
+	if (clock_hse) {
+		RCC_PREDIV1Config(RCC_PREDIV1_Div1);
+		RCC_PLLConfig(RCC_PLLSource_PREDIV1, CLOCK_HSE_PLLMUL);
+	}
+	else {
+		RCC_PLLConfig(RCC_PLLSource_HSI_Div2, RCC_PLLMul_12);	// 4 MHz * 12
+	}
+	RCC_PLLCmd(ENABLE);
+	while (RCC_GetFlagStatus(RCC_FLAG_PLLRDY) == RESET) {
+		if (--timeout == 0) {
+			RCC_PLLCmd(DISABLE);
+			return ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+/* Called with interrupts disabled, after SYSCLK switch */
+static void _clock_notify(void) {
+	RCC_ClocksTypeDef clocks;
+	uint8_t i;
+
+	SystemCoreClockUpdate();
+	RCC_GetClocksFreq(&clocks);
+	for (i = 0; i < clock_callback_count; i++) {
+		clock_callbacks[i](&clocks);
+	}
+}
+
+static ErrorStatus _clock_set(clock_freq_t freq) {
+	if (freq == CLOCK_48MHZ) {
+		// flash must be slowed down before clock is raised
+		FLASH_PrefetchBufferCmd(ENABLE);
+		FLASH_SetLatency(FLASH_Latency_1);
+		if (_clock_pll_start() == ERROR) {
+			return ERROR;	// still running from 8 MHz source, 1 wait state
+		}
+		atomic_enter();
+		_clock_switch(RCC_SYSCLKSource_PLLCLK, CLOCK_SWS_PLL);
+		clock_freq = freq;
+		_clock_notify();
+		atomic_exit();
+	}
+	else {
+		atomic_enter();
+		_clock_switch_direct();
+		clock_freq = freq;
+		_clock_notify();
+		atomic_exit();
+		RCC_PLLCmd(DISABLE);
+		// flash can be sped up after clock is lowered
+		FLASH_SetLatency(FLASH_Latency_0);
+		FLASH_PrefetchBufferCmd(DISABLE);	// no wait states: prefetch only costs current
+	}
+	return SUCCESS;
+}
+
+ErrorStatus clock_init(clock_freq_t freq) {
+	ErrorStatus status = SUCCESS;
+
+	// flash settings for 48 MHz are also correct for 8 MHz
+	FLASH_PrefetchBufferCmd(ENABLE);
+	FLASH_SetLatency(FLASH_Latency_1);
+
+	RCC_HSICmd(ENABLE);
+	#ifdef CLOCK_USE_HSE
+		RCC_HSEConfig(RCC_HSE_ON);
+		if (RCC_WaitForHSEStartUp() == SUCCESS) {
+			clock_hse = 1;
+		}
+		else {
+			status = ERROR;
+		}
+	#endif
+
+	// PLL can be configured only when it is off: run from 8 MHz source meanwhile
+	_clock_switch_direct();
+	RCC_PLLCmd(DISABLE);
+	RCC_HCLKConfig(RCC_SYSCLK_Div1);
+	RCC_PCLKConfig(RCC_HCLK_Div1);
+	clock_freq = CLOCK_8MHZ;
+
+	if (_clock_set(freq) == ERROR) {
+		status = ERROR;
+	}
+	return status;
+}
+
+ErrorStatus clock_setFrequency(clock_freq_t freq) {
+	if (freq == clock_freq) {
+		return SUCCESS;
+	}
+	return _clock_set(freq);
+}
+
+uint32_t clock_getFrequency(void) {
+	return clock_freq;
+}
+
+uint8_t clock_register(clock_callback_t callback) {
+	if (clock_callback_count >= CLOCK_MAX_CALLBACKS) {
+		return 0;
+	}
+	clock_callbacks[clock_callback_count++] = callback;
+	return 1;
+}
@@ -0,0 +1,73 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: system clock configuration #####
+																			header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * System clock: PLL (HSI/2 * 12 or HSE * CLOCK_HSE_PLLMUL) = 48 MHz, or 8 MHz directly from HSI/HSE.
+ * Flash latency and prefetch buffer are set before frequency is raised and after it is lowered.
+ * Frequency can be switched at runtime (48 MHz for bursts, 8 MHz for idle): registered drivers are
+ * notified and recalculate their timings (SysTick reload, delay_us multiplier, timer prescalers, USART BRR).
+ *
+ *	clock_init(CLOCK_48MHZ);
+ *	clock_register(systick_millis_clockUpdate);
+ *	clock_register(delay_us_clockUpdate);
+ *	clock_register(stepperClockUpdate);
+ *	clock_register(UART_ClockUpdate);
+ *	...
+ *	clock_setFrequency(CLOCK_8MHZ);
+ *
+ * Callbacks are called with interrupts disabled, right after the switch: keep them short (register writes).
+ * PLL lock time (~200 us) is spent before interrupts are disabled.
+ * USART byte being transmitted during the switch is corrupted - flush output first (log_flush(), ...).
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_CLOCK_H
+#define __STM32F0XX_CLOCK_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "stm32f0xx_rcc.h"
+#include "stm32f0xx_flash.h"
+#include "stm32f0xx_atomic.h"
+
+//#define CLOCK_USE_HSE										// crystal on OSC_IN/OSC_OUT, if it doesn't start HSI is used
+#define CLOCK_HSE_PLLMUL	RCC_PLLMul_6		// HSE * CLOCK_HSE_PLLMUL = 48 MHz (8 MHz crystal)
+#define CLOCK_MAX_CALLBACKS	8
+
+/* System clock frequency [Hz] */
+typedef enum {
+	CLOCK_8MHZ = 8000000,		// HSI or HSE, PLL off, flash: 0 wait states
+	CLOCK_48MHZ = 48000000	// PLL, flash: 1 wait state + prefetch
+} clock_freq_t;
+
+/* Driver callback: new clock frequencies */
+typedef void (*clock_callback_t)(const RCC_ClocksTypeDef* clocks);
+
+/*
+	Configure clock source, AHB and APB prescalers (1) and switch to freq. Can be called when system is
+	already running from PLL (SystemInit()). Returns ERROR if HSE is used and doesn't start - HSI is used.
+*/
+ErrorStatus clock_init(clock_freq_t freq);
+
+/* Switch system clock and notify registered drivers. Returns ERROR if PLL doesn't lock (frequency is not changed). */
+ErrorStatus clock_setFrequency(clock_freq_t freq);
+
+/* Current system clock frequency [Hz] */
+uint32_t clock_getFrequency(void);
+
+/* Register driver callback, called on each frequency change. Returns 0 if CLOCK_MAX_CALLBACKS are registered. */
+uint8_t clock_register(clock_callback_t callback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_CLOCK_H */
@@ -24,6 +24,11 @@ void delay_us_init(void) {
     us_multiplier = RCC_Clocks.SYSCLK_Frequency / 1000000; //For 1 us delay, we need to divide with 1M */
 }
 
+// system clock changed (clock_register() callback)
+void delay_us_clockUpdate(const RCC_ClocksTypeDef* clocks) {
+    us_multiplier = clocks->SYSCLK_Frequency / 1000000;
+}
+
 // delay function: micros >= 1;   
 void delay_us(uint32_t micros){
 	micros *= us_multiplier;
@@ -25,6 +25,9 @@
 
 
 void delay_us_init(void);
+
+// system clock changed: recalculate us_multiplier (register with clock_register())
+void delay_us_clockUpdate(const RCC_ClocksTypeDef* clocks);
 	 
 void delay_us(uint32_t micros);
 
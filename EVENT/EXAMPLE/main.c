@@ -0,0 +1,83 @@
+/**
+  *	Event queue test (STM32F030)
+  *	Button (PA0) and USART1 RX (PA9, PA10) interrupts post events, main loop handles them.
+  *	Send 's' for queue statistics.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds and buttons
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+#define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
+#define B1 GPIO_Pin_0	//GPIOA, PA0
+
+// events from interrupt routines
+#define EVENT_BUTTON	0
+#define EVENT_UART_RX	1
+
+void GPIO_Setup( void )
+{
+	//STM32F030 discovery onboard leds and button
+	//LEDS
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	gpio_pinSetup(GPIOC, D2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		
+	//BUTTON 
+	gpio_pinSetup(GPIOA, B1, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_interrupt(GPIOA, B1, EXTI_Trigger_Rising, 1);
+}
+
+// event data: millis() of press
+void button_handler(const event_t* event)
+{
+	gpio_toggleBit(GPIOC, D2);
+	printString("Button pressed at ");
+	printNumberLn(event->data, DEC);
+}
+
+// event data: received character
+void uart_rx_handler(const event_t* event)
+{
+	if(event->data == 's'){
+		printString("Events: max queued ");
+		printNumber(event_highWater(), DEC);
+		printString(", dropped ");
+		printNumberLn(event_dropped(), DEC);
+	}
+}
+
+int main(void)
+{	
+	uint32_t blink_time = 0;
+	
+	GPIO_Setup();
+	systick_millis_init();
+	event_register(EVENT_BUTTON, button_handler);
+	event_register(EVENT_UART_RX, uart_rx_handler);
+	UART_Init();	// PA9, PA10
+	
+	while(1){  
+		event_dispatch();
+		if((millis() - blink_time) >= 500){
+			blink_time = millis();
+			gpio_toggleBit(GPIOC, D1);
+		}
+  }
+}
+
+// PA0 (button B1) interrupt handler
+void EXTI0_1_IRQHandler(void){
+	if(reg_extiPending(EXTI_Line0))  {
+		reg_extiClear(EXTI_Line0);
+		event_post(EVENT_BUTTON, millis());
+	}
+}
+
+void USART1_IRQHandler(){
+	while(reg_usartRxReady(USART1)){
+		event_post(EVENT_UART_RX, reg_usartReceive(USART1));
+	}
+}
@@ -0,0 +1,92 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: interrupt to main loop event queue #####
+																			c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_event.h"
+
+static event_t event_queue[EVENT_QUEUE_SIZE];
+static atomic_ring_t event_ring = {0, 0, EVENT_QUEUE_SIZE - 1};	// producers: interrupts (serialized), consumer: main loop
+static event_handler_t event_handlers[EVENT_TYPES];
+static uint16_t event_high_water = 0;
+static volatile uint32_t event_drop_count = 0;
+
+uint8_t event_register(uint8_t type, event_handler_t handler)
+{
+	if(type >= EVENT_TYPES){
+		return 0;
+	}
+	event_handlers[type] = handler;
+	return 1;
+}
+
+uint8_t event_post(uint8_t type, uint32_t data)
+{
+	event_t* event;
+	uint16_t count;
+	
+	atomic_enter();	// other interrupt routine can't take the same slot
+	if(atomic_ringFull(&event_ring)){
+		event_drop_count++;
+		atomic_exit();
+		return 0;
+	}
+	event = &event_queue[atomic_ringHead(&event_ring)];
+	event->type = type;
+	event->data = data;
+	atomic_ringPush(&event_ring);
+	count = atomic_ringCount(&event_ring);
+	if(count > event_high_water){
+		event_high_water = count;
+	}
+	atomic_exit();
+	return 1;
+}
+
+uint8_t event_dispatchOne(void)
+{
+	event_t event;
+	
+	if(atomic_ringEmpty(&event_ring)){
+		return 0;
+	}
+	event = event_queue[atomic_ringTail(&event_ring)];	// copy: slot is free for producers while handler runs
+	atomic_ringPop(&event_ring);
+	if((event.type < EVENT_TYPES) && (event_handlers[event.type] != 0)){
+		event_handlers[event.type](&event);
+	}
+	return 1;
+}
+
+uint16_t event_dispatch(void)
+{
+	uint16_t dispatched = 0;
+	
+	while(event_dispatchOne()){
+		dispatched++;
+	}
+	return dispatched;
+}
+
+uint16_t event_highWater(void)
+{
+	return event_high_water;
+}
+
+uint32_t event_dropped(void)
+{
+	return event_drop_count;
+}
+
+void event_resetStats(void)
+{
+	atomic_enter();
+	event_high_water = atomic_ringCount(&event_ring);
+	event_drop_count = 0;
+	atomic_exit();
+}
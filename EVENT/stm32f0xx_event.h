@@ -0,0 +1,69 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: interrupt to main loop event queue #####
+																		header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Interrupt routines only post small events (type + 32 bit data), main loop dispatches them to handlers, 
+ * one at a time, each handler runs to completion. Blocking work (printing, LCD, ...) is done in handlers,
+ * so interrupt routines stay short.
+ *
+ *	#define EVENT_BUTTON	0
+ *	void button_handler(const event_t* event){ gpio_toggleBit(GPIOC, D2); }
+ *
+ *	event_register(EVENT_BUTTON, button_handler);
+ *	while(1){ event_dispatch(); ... }
+ *
+ *	void EXTI0_1_IRQHandler(void){ ... event_post(EVENT_BUTTON, 0); }
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_EVENT_H
+#define __STM32F0XX_EVENT_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "stm32f0xx_atomic.h"
+
+#define EVENT_QUEUE_SIZE	32		// must be power of 2, one slot is always free
+#define EVENT_TYPES				16		// event types 0 - (EVENT_TYPES-1)
+
+typedef struct {
+	uint8_t type;
+	uint32_t data;	// e.g. received byte, pin, millis()
+} event_t;
+
+typedef void (*event_handler_t)(const event_t* event);
+
+/* Set handler of event type (0: events of this type are discarded). Returns 0 if type is out of range. */
+uint8_t event_register(uint8_t type, event_handler_t handler);
+
+/*
+	Interrupt routines (or main loop): add event to queue. Returns 0 if queue is full - event is dropped and counted.
+	Cortex-M0 has no exclusive load/store: slot of event is reserved and written with interrupts disabled (a few cycles),
+	so any interrupt priority can post.
+*/
+uint8_t event_post(uint8_t type, uint32_t data);
+
+/* Main loop: call handlers of all queued events (also events posted meanwhile). Returns number of dispatched events. */
+uint16_t event_dispatch(void);
+
+/* Main loop: call handler of oldest event only. Returns 0 if queue is empty. */
+uint8_t event_dispatchOne(void);
+
+/* Statistics: max number of queued events (high-water mark), number of dropped events */
+uint16_t event_highWater(void);
+uint32_t event_dropped(void);
+void event_resetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_EVENT_H */
@@ -14,13 +14,7 @@
 // Toggle bit
 void gpio_toggleBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
 {
-	if(GPIO_ReadOutputDataBit(GPIOx, GPIO_Pin) ==  Bit_SET){
-		GPIO_WriteBit(GPIOx, GPIO_Pin, Bit_RESET);
-	}
-	else{
-		GPIO_WriteBit(GPIOx, GPIO_Pin, Bit_SET);
-	}
-	
+	reg_gpioToggle(GPIOx, GPIO_Pin);
 }
 
 /*
@@ -234,8 +228,8 @@ void gpio_pinSetup_interrupt(GPIO_TypeDef* GPIOx, uint32_t pinNumber, EXTITrigge
 Note: for correct EXTIX_IRQ interrupt handler check switch state 
 
 void EXTI0_1_IRQHandler(void){
-	if(EXTI_GetITStatus(EXTI_Line0) != RESET)  {	
-		EXTI_ClearFlag(EXTI_Line0);
+	if(reg_extiPending(EXTI_Line0))  {	
+		reg_extiClear(EXTI_Line0);
 		gpio_toggleBit(GPIOC, D2);
 	}
 }*/
@@ -20,6 +20,8 @@
 #include <stm32f0xx_rcc.h>
 #include <stm32f0xx_misc.h>
 
+#include "stm32f0xx_reg.h"
+
 
 #ifdef __cplusplus
   extern "C" {
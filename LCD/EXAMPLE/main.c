@@ -48,6 +48,8 @@ int main(void)
 	LCD_CreateChar(0, custom_char);
 	LCD_PutCustom(1,10, 0);
 	
+	LCD_Flush();	// send changed characters if LCD_USE_FRAME_BUFFER is defined
+	
 	while (1)
   {
 		gpio_toggleBit(GPIOC, D2);
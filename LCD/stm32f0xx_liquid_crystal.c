@@ -8,58 +8,232 @@
  */
 
 #include "stm32f0xx_liquid_crystal.h"
+#include <string.h>
 
 /* Private variable */
-static _lcd_options_t _lcd_options;
+static lcd_struct _lcd_default;						// display with LCD_E_Pin, used if no other display is selected
+static lcd_struct* _lcd = &_lcd_default;	// selected display
+static lcd_struct* _lcd_displays[LCD_MAX_DISPLAYS];	// initialized displays
+static uint8_t _lcd_display_count = 0;
+static uint8_t _lcd_bus_ready = 0;				// shared pins (peripheral) initialized
+static uint32_t _lcd_ticks_per_us;				// SysTick
+
+static void _lcd_settle(uint16_t us);
+static void _lcd_settle_wait(void);
+#if defined(LCD_USE_BUSY_FLAG) && !defined(LCD_USE_ASYNC)
+	static void _lcd_busy_check(void);
+#endif
+
+/* 
+	Data pins and RS grouped by GPIO port: BSRR value for each nibble, precalculated in _lcd_init_pins().
+	Nibble (byte) and RS are written with one store per port.
+*/
+#ifdef LCD_USE_8BIT
+	#define LCD_MAX_PORTS		9		// D0-D7 and RS on different ports
+#else
+	#define LCD_MAX_PORTS		5		// D4-D7 and RS on different ports
+#endif
+typedef struct {
+	GPIO_TypeDef* port;
+	uint32_t nibble_bsrr[16];	// D4-D7 pins of this port
+	#ifdef LCD_USE_8BIT
+		uint32_t low_bsrr[16];	// D0-D3 pins of this port
+	#endif
+	uint32_t rs_bsrr[2];			// RS pin of this port: [0] reset, [1] set
+} _lcd_port_t;
+
+static _lcd_port_t _lcd_ports[LCD_MAX_PORTS];
+static uint8_t _lcd_port_count = 0;
+
+#ifdef LCD_USE_8BIT
+#define LCD_BUS_NOT_CONTIGUOUS	0xFF
+static uint8_t _lcd_bus_shift = LCD_BUS_NOT_CONTIGUOUS;	// D0 pin number if D0-D7 are consecutive pins of _lcd_ports[0]
+#endif
+
+static void _lcd_add_pin(GPIO_TypeDef* port, uint16_t pin, uint8_t bit);
+
+/* DDRAM address of each row */
+static const uint8_t _lcd_row_offsets[4] = {0x00, 0x40, 0x14, 0x54};
+
+#ifdef LCD_USE_ASYNC
+/* Queue entry: bits 0-7 byte, flags: */
+#define LCD_QUEUE_RS				0x0100		// data register
+#define LCD_QUEUE_NIBBLE		0x0200		// power on sequence: single nibble (bits 0-3)
+#define LCD_QUEUE_DELAY			0x0400		// no transfer, only wait
+#define LCD_QUEUE_WAIT_POS	11				// bits 11-12: wait after transfer, index in _lcd_async_wait_us
+#define LCD_QUEUE_WAIT_2MS	(1 << LCD_QUEUE_WAIT_POS)	// clear, home
+#define LCD_QUEUE_WAIT_5MS	(2 << LCD_QUEUE_WAIT_POS)	// power on
+#define LCD_QUEUE_WAIT_50MS	(3 << LCD_QUEUE_WAIT_POS)
+#define LCD_QUEUE_DISPLAY_POS	13				// bits 13-15: display, index in _lcd_displays
+
+/* Interrupt states */
+#define LCD_ASYNC_NEXT			0		// fetch next entry, first nibble, E high
+#define LCD_ASYNC_E_LOW			1		// E low after first nibble
+#define LCD_ASYNC_SECOND		2		// second nibble, E high
+#define LCD_ASYNC_E_LOW_LAST	3		// E low, then wait execution time
+
+static const uint16_t _lcd_async_wait_us[4] = {LCD_ASYNC_EXEC_US, 2000, 5000, 50000};
+
+static uint16_t _lcd_queue[LCD_QUEUE_SIZE];
+static atomic_ring_t _lcd_queue_ring = {0, 0, LCD_QUEUE_SIZE - 1};	// main: producer, interrupt: consumer
+static volatile uint8_t _lcd_async_busy = 0;	// timer running
+static uint8_t _lcd_async_state = LCD_ASYNC_NEXT;
+static uint16_t _lcd_async_entry;							// entry in progress
+static lcd_struct* _lcd_async_lcd;						// display of entry in progress
+
+static void _lcd_async_init(void);
+static void _lcd_queue_push(uint16_t entry);
+#endif
+
+#ifdef LCD_USE_I2C
+#define LCD_I2C_RS				0x01		// port expander pins
+#define LCD_I2C_E					0x04
+#define LCD_I2C_BACKLIGHT	0x08
+
+static uint8_t _lcd_i2c_buffer[LCD_I2C_BUFFER_SIZE];	// port expander states of one transfer
+static uint8_t _lcd_i2c_length = 0;
+static uint8_t _lcd_i2c_busy = 0;											// DMA transfer in progress
+
+static void _lcd_i2c_init(void);
+static void _lcd_i2c_send_init_nibble(uint8_t nibble, uint8_t long_wait);
+static void _lcd_i2c_send(uint8_t byte, uint8_t rs);
+static void _lcd_i2c_send_run(const uint8_t* data, uint8_t length);
+static uint8_t _lcd_i2c_begin(uint8_t rs);
+static void _lcd_i2c_start(void);
+
+static const _lcd_transport_t _lcd_transport = {_lcd_i2c_init, _lcd_i2c_send_init_nibble, _lcd_i2c_send, _lcd_i2c_send_run};
+#else
+static void _lcd_gpio_init(void);
+static void _lcd_gpio_send_init_nibble(uint8_t nibble, uint8_t long_wait);
+static void _lcd_gpio_send(uint8_t byte, uint8_t rs);
+
+static const _lcd_transport_t _lcd_transport = {_lcd_gpio_init, _lcd_gpio_send_init_nibble, _lcd_gpio_send, 0};
+#endif
+
+static void _lcd_glyph_upload(uint8_t slot, const uint8_t* bitmap);
+static char* _lcd_format_number(char* end, uint32_t number, uint8_t digits);
+static void _lcd_address_advance(uint8_t length);
+static void _lcd_glyph_touch(uint8_t slot);
+
+#define LCD_LINE_LENGTH		40		// DDRAM characters per line
+
+/* Big digits: 7-segment code of 0 - 9, bit 0 = a (top) ... bit 6 = g (middle) */
+static const uint8_t _lcd_big_segments[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+static const uint8_t _lcd_big_bitmaps[3][8] = {
+	{0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00},	// LCD_GLYPH_BIG_TOP
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F},	// LCD_GLYPH_BIG_BOTTOM
+	{0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x1F, 0x1F, 0x1F}	// LCD_GLYPH_BIG_BOTH
+};
+
+static void _lcd_marquee_reset(void);
+static void _lcd_marquee_write(uint8_t row, uint32_t from, uint32_t to);
+
+#ifdef LCD_USE_FRAME_BUFFER
+/* Rows in DDRAM address order: on 4 row displays row 2 continues row 0 (auto increment) */
+static const uint8_t _lcd_flush_order[4] = {0, 2, 1, 3};
+
+static uint8_t _lcd_flush_run(uint8_t max);
+#endif
+
+void LCD_Select(lcd_struct* lcd) {
+	_lcd = lcd ? lcd : &_lcd_default;
+}
 
 void LCD_Init(uint8_t rows, uint8_t cols) {
 	systick_millis_init();	// Initialize milisecond delay 
 	delay_us_init();				// Initialize microsecond delay 
+	_lcd_ticks_per_us = (SysTick->LOAD + 1) / 1000;	// SysTick period is 1 ms
+	
+	// Default pins, add to list of displays
+	if (_lcd->E_Port == 0) {
+		_lcd->E_Port = LCD_E_Port;
+		_lcd->E_Pin = LCD_E_Pin;
+	}
+	if (_lcd->I2C_Address == 0) {
+		_lcd->I2C_Address = LCD_I2C_ADDRESS;
+	}
+	if (_lcd->index == 0) {
+		if (_lcd_display_count == LCD_MAX_DISPLAYS) {
+			return;	// too many displays
+		}
+		_lcd_displays[_lcd_display_count++] = _lcd;
+		_lcd->index = _lcd_display_count;
+	}
+	_lcd->settle_us = 0;
 	
-	_lcd_init_pins();	// Init pinout 
-	delay(50);	//At least 40ms
+	_lcd->options.BusyFlag = 0;	// busy flag can't be read before interface is set
+	_lcd->options.Address = LCD_ADDRESS_UNKNOWN;
+	_lcd->options.Backlight = 1;
+	_lcd_transport.init();	// Init pinout, wait at least 40ms
+	LCD_GlyphReset();				// CGRAM content is unknown after power on
+	_lcd_marquee_reset();
 	
 	// Set LCD width and height 
-	_lcd_options.Rows = rows;
-	_lcd_options.Cols = cols;
+	#ifdef LCD_USE_FRAME_BUFFER
+		if(rows > LCD_FB_ROWS) rows = LCD_FB_ROWS;
+		if(cols > LCD_FB_COLS) cols = LCD_FB_COLS;
+	#endif
+	_lcd->options.Rows = rows;
+	_lcd->options.Cols = cols;
 	// Set cursor pointer to beginning for LCD 
-	_lcd_options.currentX = 0;
-	_lcd_options.currentY = 0;
+	_lcd->options.currentX = 0;
+	_lcd->options.currentY = 0;
 	
-	_lcd_options.DisplayFunction = LCD_4BITMODE | LCD_5x8DOTS | LCD_1LINE;
+	#ifdef LCD_USE_8BIT
+		_lcd->options.DisplayFunction = LCD_8BITMODE | LCD_5x8DOTS | LCD_1LINE;
+	#else
+		_lcd->options.DisplayFunction = LCD_4BITMODE | LCD_5x8DOTS | LCD_1LINE;
+	#endif
 	if (rows > 1) {
-		_lcd_options.DisplayFunction |= LCD_2LINE;
+		_lcd->options.DisplayFunction |= LCD_2LINE;
 	}
 	
 	/* Try to set 4bit mode */
-	_lcd_send_command_4_bit(0x03);
-	delay(5);
+	_lcd_transport.send_init_nibble(0x03, 1);
 	
 	/* Second try */
-	_lcd_send_command_4_bit(0x03);
-	delay(5);
+	_lcd_transport.send_init_nibble(0x03, 1);
 	
 	/* Third goo! */
-	_lcd_send_command_4_bit(0x03);
-	delay(5);	
+	_lcd_transport.send_init_nibble(0x03, 1);
 	
-	/* Set 4-bit interface */
-	_lcd_send_command_4_bit(0x02);
-	delay_us(100);
+	#ifndef LCD_USE_8BIT
+		/* Set 4-bit interface */
+		_lcd_transport.send_init_nibble(0x02, 0);
+	#endif
 	
 	// Set # lines, font size, etc.
-	_lcd_send_command(LCD_FUNCTIONSET | _lcd_options.DisplayFunction);
+	_lcd_send_command(LCD_FUNCTIONSET | _lcd->options.DisplayFunction);
 
 	// Turn the display on, no cursor, no blinking
-	_lcd_options.DisplayControl = LCD_DISPLAYON;
+	_lcd->options.DisplayControl = LCD_DISPLAYON;
 	LCD_DisplayOn();
 
-	LCD_Clear();
+	// Clear display
+	_lcd_send_command(LCD_CLEARDISPLAY);
+	#if defined(LCD_USE_BUSY_FLAG) && !defined(LCD_USE_ASYNC)
+		_lcd_busy_check();	// from now on wait for busy flag, if R/W is connected
+	#endif
+	#ifdef LCD_USE_FRAME_BUFFER
+		memset(_lcd->frame, ' ', sizeof(_lcd->frame));
+		memset(_lcd->shown, ' ', sizeof(_lcd->shown));
+	#endif
 
 	// Default font & direction
-	_lcd_options.DisplayMode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
-	_lcd_send_command(LCD_ENTRYMODESET | _lcd_options.DisplayMode);
-	delay(5);
+	_lcd->options.DisplayMode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+	_lcd_send_command(LCD_ENTRYMODESET | _lcd->options.DisplayMode);
+	#ifndef LCD_USE_ASYNC
+		delay(5);
+	#endif
+}
+
+void LCD_ClockUpdate(const RCC_ClocksTypeDef* clocks) {
+	// SysTick runs from HCLK, SysTick->LOAD may not be updated yet (callback order)
+	_lcd_ticks_per_us = clocks->HCLK_Frequency / 1000000;
+	#ifdef LCD_USE_ASYNC
+		TIM_PrescalerConfig(LCD_TIM, (clocks->HCLK_Frequency / 1000000) - 1, TIM_PSCReloadMode_Update);	// 1us timer increment
+	#endif
+	// delay_us(): delay_us_clockUpdate()
 }
 
 /*
@@ -70,37 +244,7 @@ void LCD_Init(uint8_t rows, uint8_t cols) {
  */
 void LCD_PrintString(uint8_t y, uint8_t x, char* str) {
 	_lcd_cursor_set(y, x);
-	while (*str) {
-		#ifdef GO_TO_NEW_LINE_IF_STRING_TOO_LONG
-			if (_lcd_options.currentX >= _lcd_options.Cols) {
-				_lcd_options.currentX = 0;
-				_lcd_options.currentY++;
-				_lcd_cursor_set(_lcd_options.currentY, _lcd_options.currentX);
-			}
-			if (*str == '\n') {
-				_lcd_options.currentY++;
-				_lcd_cursor_set(_lcd_options.currentY, _lcd_options.currentX);
-			} else if (*str == '\r') {
-				_lcd_cursor_set(_lcd_options.currentY, 0);
-			} else {
-				_lcd_send_data(*str);
-				_lcd_options.currentX++;
-			}
-			str++;
-		#else
-			if (*str == '\n') {
-				_lcd_options.currentY++;
-				_lcd_cursor_set(_lcd_options.currentY, _lcd_options.currentX);
-			} else if (*str == '\r') {
-				_lcd_cursor_set(_lcd_options.currentY, 0);
-			} else {
-				_lcd_send_data(*str);
-				_lcd_options.currentX++;
-			}
-			str++;
-		#endif
-		
-	}
+	LCD_Write(str);
 }
 
 /*
@@ -110,31 +254,8 @@ void LCD_PrintString(uint8_t y, uint8_t x, char* str) {
 	number = in32_t (range: -2147483647 to 2147483647)
  */
 void LCD_PrintNumber(uint8_t y, uint8_t x, int32_t number){
-	char buf[3*sizeof(number)+1];		// emty 8-bit buffer with size of 3*int32_t number; max 12 characters, including minus; + ending character
-	char *str = &buf[sizeof(buf)-1];	// pointer on buffer address of the last byte
-	uint32_t _number;
-	char c;
-	*str = '\0';
-	
-	if(number < 0){
-		LCD_PrintString(y, x, "-");
-		x++;
-		number = -number;
-	}
-	
-	do{
-		_number = number;
-		number /= 10;
-		c = _number - 10 * number;	// residue
-		str--;
-		if(c < 10){
-			*str = c + '0';
-		}
-		else{
-			*str = c + 'A' - 10;
-		}
-	} while(number);
-	LCD_PrintString(y, x, str);
+	_lcd_cursor_set(y, x);
+	LCD_WriteNumber(number);
 }
 
 /*
@@ -144,71 +265,154 @@ void LCD_PrintNumber(uint8_t y, uint8_t x, int32_t number){
 	number = float (range: -2147483647 to 2147483647)
  */
 void LCD_PrintFloat(uint8_t y, uint8_t x, float number_f){
-	int32_t integer_part = (int32_t) number_f;
-	float decimal_part = (number_f - (float)integer_part) * 10000;
-		
-	if((integer_part == 0) && (decimal_part < 0)){
-		LCD_PrintString(y, x, "-");
-		x++;
+	_lcd_cursor_set(y, x);
+	LCD_WriteFloat(number_f);
+}
+
+void LCD_SetCursor(uint8_t y, uint8_t x) {
+	_lcd_cursor_set(y, x);
+	#ifndef LCD_USE_FRAME_BUFFER
+		if (_lcd->options.DisplayControl & (LCD_CURSORON | LCD_BLINKON)) {
+			_lcd_cursor_sync();	// visible cursor: move it now, not before next character
+		}
+	#endif
+}
+
+void LCD_Write(const char* str) {
+	uint8_t length;
+	
+	while (*str) {
+		#ifdef GO_TO_NEW_LINE_IF_STRING_TOO_LONG
+			if (_lcd->options.currentX >= _lcd->options.Cols) {
+				_lcd->options.currentX = 0;
+				_lcd->options.currentY++;
+				_lcd_cursor_set(_lcd->options.currentY, _lcd->options.currentX);
+			}
+		#endif
+		if (*str == '\n') {
+			_lcd->options.currentY++;
+			_lcd_cursor_set(_lcd->options.currentY, _lcd->options.currentX);
+			str++;
+		} else if (*str == '\r') {
+			_lcd_cursor_set(_lcd->options.currentY, 0);
+			str++;
+		} else {
+			// characters up to next control character are sent in one transfer
+			length = 0;
+			while (str[length] && (str[length] != '\n') && (str[length] != '\r') && (length < 255)) {
+				length++;
+				#ifdef GO_TO_NEW_LINE_IF_STRING_TOO_LONG
+					if ((_lcd->options.currentX + length) >= _lcd->options.Cols) {
+						break;
+					}
+				#endif
+			}
+			_lcd_put_chars(str, length);
+			str += length;
+		}
 	}
-	LCD_PrintNumber(y, x, integer_part);
-	x = _lcd_options.currentX++;
-	LCD_PrintString(y, x, ".");
-	x = _lcd_options.currentX++;
+}
+
+void LCD_WriteNumber(int32_t number) {
+	char buf[3*sizeof(number)+1];		// max 11 characters, including minus; + ending character
+	char *str = &buf[sizeof(buf)-1];	// pointer on buffer address of the last byte
 	
+	*str = '\0';
+	if (number < 0) {
+		str = _lcd_format_number(str, 0 - (uint32_t)number, 1);
+		*--str = '-';
+	}
+	else {
+		str = _lcd_format_number(str, number, 1);
+	}
+	LCD_Write(str);
+}
+
+void LCD_WriteFloat(float number_f) {
+	char buf[3*sizeof(int32_t)+7];	// minus, integer part, '.', 4 decimals, ending character
+	char *str = &buf[sizeof(buf)-1];
+	int32_t integer_part = (int32_t) number_f;
+	float decimal_part = (number_f - (float)integer_part) * 10000;
+	uint8_t negative = (integer_part < 0) || (decimal_part < 0);	// -0.5: integer part is 0
 	
-	if(decimal_part < 0){
+	if (decimal_part < 0) {
 		decimal_part = -decimal_part;
 	}
-	if(decimal_part < 1000){
-		
-		if(decimal_part < 100){
-			LCD_PrintNumber(y, x, 0); 
-			x = _lcd_options.currentX++;
-		}
-		if(decimal_part < 10){
-			LCD_PrintNumber(y, x, 0); 
-			x = _lcd_options.currentX++;
-		}
-		LCD_PrintNumber(y, x, 0); 
-		x = _lcd_options.currentX++;
+	*str = '\0';
+	str = _lcd_format_number(str, (uint32_t)decimal_part, 4);
+	*--str = '.';
+	str = _lcd_format_number(str, negative ? 0 - (uint32_t)integer_part : (uint32_t)integer_part, 1);
+	if (negative) {
+		*--str = '-';
 	}
-	LCD_PrintNumber(y, x, (uint32_t)decimal_part); 
+	LCD_Write(str);
 }
 
 void LCD_Clear(void) {
-	_lcd_send_command(LCD_CLEARDISPLAY);
-	delay(3);
+	_lcd_marquee_reset();
+	#ifdef LCD_USE_FRAME_BUFFER
+		memset(_lcd->frame, ' ', sizeof(_lcd->frame));	// cleared on next flush
+	#else
+		_lcd_send_command(LCD_CLEARDISPLAY);
+	#endif
+}
+
+void LCD_Flush(void) {
+	#ifdef LCD_USE_FRAME_BUFFER
+		_lcd->flush_order = 0;
+		_lcd->flush_col = 0;
+		while (_lcd_flush_run(LCD_FB_COLS));
+	#endif
+}
+
+void LCD_FlushAll(void) {
+	#ifdef LCD_USE_FRAME_BUFFER
+		lcd_struct* selected = _lcd;
+		uint8_t i, pending;
+		
+		for (i = 0; i < _lcd_display_count; i++) {
+			_lcd_displays[i]->flush_order = 0;
+			_lcd_displays[i]->flush_col = 0;
+		}
+		do {
+			pending = 0;
+			for (i = 0; i < _lcd_display_count; i++) {
+				_lcd = _lcd_displays[i];
+				pending |= _lcd_flush_run(1);
+			}
+		} while (pending);
+		_lcd = selected;
+	#endif
 }
 
 void LCD_DisplayOn(void) {
-	_lcd_options.DisplayControl |= LCD_DISPLAYON;
-	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd_options.DisplayControl);
+	_lcd->options.DisplayControl |= LCD_DISPLAYON;
+	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd->options.DisplayControl);
 }
 
 void LCD_DisplayOff(void) {
-	_lcd_options.DisplayControl &= ~LCD_DISPLAYON;
-	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd_options.DisplayControl);
+	_lcd->options.DisplayControl &= ~LCD_DISPLAYON;
+	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd->options.DisplayControl);
 }
 
 void LCD_BlinkOn(void) {
-	_lcd_options.DisplayControl |= LCD_BLINKON;
-	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd_options.DisplayControl);
+	_lcd->options.DisplayControl |= LCD_BLINKON;
+	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd->options.DisplayControl);
 }
 
 void LCD_BlinkOff(void) {
-	_lcd_options.DisplayControl &= ~LCD_BLINKON;
-	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd_options.DisplayControl);
+	_lcd->options.DisplayControl &= ~LCD_BLINKON;
+	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd->options.DisplayControl);
 }
 
 void LCD_CursorOn(void) {
-	_lcd_options.DisplayControl |= LCD_CURSORON;
-	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd_options.DisplayControl);
+	_lcd->options.DisplayControl |= LCD_CURSORON;
+	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd->options.DisplayControl);
 }
 
 void LCD_CursorOff(void) {
-	_lcd_options.DisplayControl &= ~LCD_CURSORON;
-	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd_options.DisplayControl);
+	_lcd->options.DisplayControl &= ~LCD_CURSORON;
+	_lcd_send_command(LCD_DISPLAYCONTROL | _lcd->options.DisplayControl);
 }
 
 void LCD_ScrollLeft(void) {
@@ -219,73 +423,770 @@ void LCD_ScrollRight(void) {
 	_lcd_send_command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
 }
 
+void LCD_Marquee(uint8_t y, const char* text) {
+	_lcd_marquee_t* m;
+	
+	if (y > 1) {
+		return;
+	}
+	m = &_lcd->marquee[y];
+	m->text = text;
+	m->length = text ? strlen(text) : 0;
+	m->period = (m->length <= LCD_LINE_LENGTH) ? LCD_LINE_LENGTH : (m->length + LCD_MARQUEE_GAP);
+	
+	// whole DDRAM line: visible part and off-screen part
+	m->filled = _lcd->marquee_step + LCD_LINE_LENGTH;
+	_lcd_marquee_write(y, _lcd->marquee_step, m->filled);
+}
+
+void LCD_MarqueeStart(uint16_t step_ms) {
+	_lcd->marquee_ms = step_ms;
+	_lcd->marquee_time = millis();
+}
+
+void LCD_MarqueeStop(void) {
+	uint8_t row;
+	
+	_lcd->marquee_ms = 0;
+	if (_lcd->marquee_step == 0) {
+		return;
+	}
+	_lcd->marquee_step = 0;
+	_lcd_send_command(LCD_RETURNHOME);	// display shift = 0
+	for (row = 0; row < 2; row++) {
+		if (_lcd->marquee[row].period != LCD_LINE_LENGTH) {	// text longer than DDRAM line: from start
+			_lcd->marquee[row].filled = LCD_LINE_LENGTH;
+			_lcd_marquee_write(row, 0, LCD_LINE_LENGTH);
+		}
+	}
+}
+
+void LCD_MarqueeTask(void) {
+	_lcd_marquee_t* m;
+	uint8_t row, refill;
+	uint32_t end;
+	
+	if ((_lcd->marquee_ms == 0) || ((millis() - _lcd->marquee_time) < _lcd->marquee_ms)) {
+		return;
+	}
+	_lcd->marquee_time += _lcd->marquee_ms;
+	if ((millis() - _lcd->marquee_time) >= _lcd->marquee_ms) {
+		_lcd->marquee_time = millis();	// late: skip missed steps
+	}
+	_lcd->marquee_step++;
+	_lcd_send_command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
+	
+	/* 
+		Characters that scrolled out on the left are off-screen on the right: write next part of text there.
+		Shift first: last refilled position (marquee_step + LCD_LINE_LENGTH - 1) is the column that just scrolled out.
+	*/
+	refill = LCD_MARQUEE_REFILL;
+	if (refill > (LCD_LINE_LENGTH - _lcd->options.Cols)) {
+		refill = LCD_LINE_LENGTH - _lcd->options.Cols;
+	}
+	if (refill == 0) {
+		refill = 1;
+	}
+	end = _lcd->marquee_step + LCD_LINE_LENGTH;
+	for (row = 0; row < 2; row++) {
+		m = &_lcd->marquee[row];
+		if ((m->period != LCD_LINE_LENGTH) && ((end - m->filled) >= refill)) {
+			_lcd_marquee_write(row, m->filled, end);
+			m->filled = end;
+		}
+	}
+}
+
+void LCD_Backlight(uint8_t state) {
+	_lcd->options.Backlight = (state != 0);
+	#ifdef LCD_USE_I2C
+		// backlight bit is sent with every transfer, send state now
+		_lcd_i2c_begin(0);
+		_lcd_i2c_start();
+	#endif
+}
+
 void LCD_CreateChar(uint8_t location, uint8_t *data) {
-	uint8_t i;
 	/* We have 8 locations available for custom characters */
 	location &= 0x07;
-	_lcd_send_command(LCD_SETCGRAMADDR | (location << 3));
+	_lcd->glyph_id[location] = LCD_GLYPH_NONE;
+	_lcd->glyph_pinned |= (1 << location);	// not used by glyph cache
+	_lcd_glyph_upload(location, data);
+}
+
+void LCD_PutCustom(uint8_t y, uint8_t x, uint8_t location) {
+	_lcd_cursor_set(y, x);
+	_lcd_put_char(location);
+}
+
+uint8_t LCD_GlyphSlot(uint8_t id, const uint8_t* bitmap) {
+	uint8_t i, slot;
 	
-	for (i = 0; i < 8; i++) {
-		_lcd_send_data(data[i]);
+	for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+		if (_lcd->glyph_id[slot] == id) {
+			break;
+		}
 	}
+	if (slot == LCD_GLYPH_SLOTS) {
+		// not in CGRAM: least recently used slot, or slot that already has this bitmap
+		slot = LCD_GLYPH_NONE;
+		for (i = LCD_GLYPH_SLOTS; i > 0; i--) {
+			if (_lcd->glyph_pinned & (1 << _lcd->glyph_lru[i - 1])) {
+				continue;
+			}
+			if (slot == LCD_GLYPH_NONE) {
+				slot = _lcd->glyph_lru[i - 1];
+			}
+			if ((_lcd->glyph_loaded & (1 << _lcd->glyph_lru[i - 1])) && (memcmp(_lcd->glyph_bitmap[_lcd->glyph_lru[i - 1]], bitmap, 8) == 0)) {
+				slot = _lcd->glyph_lru[i - 1];
+				break;
+			}
+		}
+		if (slot == LCD_GLYPH_NONE) {
+			return LCD_GLYPH_NONE;	// all slots used by LCD_CreateChar()
+		}
+		_lcd->glyph_id[slot] = id;
+	}
+	_lcd_glyph_upload(slot, bitmap);	// skipped if bitmap didn't change
+	_lcd_glyph_touch(slot);
+	
+	return slot;
 }
 
-void LCD_PutCustom(uint8_t y, uint8_t x, uint8_t location) {
+void LCD_PutGlyph(uint8_t y, uint8_t x, uint8_t id, const uint8_t* bitmap) {
+	uint8_t slot = LCD_GlyphSlot(id, bitmap);
+	
+	if (slot == LCD_GLYPH_NONE) {
+		return;	// no free slot
+	}
 	_lcd_cursor_set(y, x);
-	_lcd_send_data(location);
+	_lcd_put_char(slot);
+}
+
+void LCD_GlyphReset(void) {
+	uint8_t i;
+	
+	for (i = 0; i < LCD_GLYPH_SLOTS; i++) {
+		_lcd->glyph_id[i] = LCD_GLYPH_NONE;
+		_lcd->glyph_lru[i] = i;
+	}
+	_lcd->glyph_loaded = 0;
+	_lcd->glyph_pinned = 0;
+}
+
+void LCD_BarGraph(uint8_t y, uint8_t x, uint8_t width, uint16_t value, uint16_t max) {
+	char bar[LCD_LINE_LENGTH];
+	uint8_t bitmap[8];
+	uint8_t i, full, partial;
+	uint8_t slot = ' ';
+	uint16_t pixels = 0;
+	
+	if (width > LCD_LINE_LENGTH) {
+		width = LCD_LINE_LENGTH;
+	}
+	if (value > max) {
+		value = max;
+	}
+	if (max) {
+		pixels = ((uint32_t)value * width * 5 + (max >> 1)) / max;	// rounded
+	}
+	full = pixels / 5;
+	partial = pixels - full * 5;
+	
+	if (partial) {
+		// one glyph per bar length: no upload while bar is animated, once all are in CGRAM
+		memset(bitmap, (0x1F << (5 - partial)) & 0x1F, sizeof(bitmap));
+		slot = LCD_GlyphSlot(LCD_GLYPH_BAR + partial, bitmap);
+		if (slot == LCD_GLYPH_NONE) {
+			slot = ' ';	// no free slot: partial character is not shown
+		}
+	}
+	for (i = 0; i < width; i++) {
+		if (i < full) {
+			bar[i] = LCD_CHAR_FULL_BLOCK;
+		}
+		else if (i == full) {
+			bar[i] = slot;
+		}
+		else {
+			bar[i] = ' ';
+		}
+	}
+	_lcd_cursor_set(y, x);
+	_lcd_put_chars(bar, width);
+}
+
+void LCD_BigDigit(uint8_t y, uint8_t x, uint8_t digit) {
+	char cells[3];
+	char bars[4] = {' ', ' ', ' ', ' '};	// character for horizontal bars: none, top, bottom, both
+	uint8_t i, row, horizontal, left, right;
+	uint8_t segments = 0;
+	
+	if (digit < 10) {
+		segments = _lcd_big_segments[digit];
+		for (i = 0; i < 3; i++) {
+			bars[i + 1] = LCD_GlyphSlot(LCD_GLYPH_BIG_TOP + i, _lcd_big_bitmaps[i]);
+			if (bars[i + 1] == (char)LCD_GLYPH_NONE) {
+				return;	// no free slot: digit is not drawn
+			}
+		}
+	}
+	for (row = 0; row < 2; row++) {
+		if (row == 0) {
+			horizontal = (segments & 0x01) | ((segments >> 5) & 0x02);	// a: top, g: bottom
+			left = segments & 0x20;		// f
+			right = segments & 0x02;	// b
+		}
+		else {
+			horizontal = ((segments >> 6) & 0x01) | ((segments >> 2) & 0x02);	// g: top, d: bottom
+			left = segments & 0x10;		// e
+			right = segments & 0x04;	// c
+		}
+		cells[0] = left ? LCD_CHAR_FULL_BLOCK : bars[horizontal];
+		cells[1] = bars[horizontal];
+		cells[2] = right ? LCD_CHAR_FULL_BLOCK : bars[horizontal];
+		_lcd_cursor_set(y + row, x);
+		_lcd_put_chars(cells, 3);
+	}
 }
 
 /* Private functions */
 void _lcd_send_command(uint8_t cmd) {
-	/* Command mode */
-	GPIO_ResetBits(LCD_RS_Port, LCD_RS_Pin);
-		
-	/* High nibble */
-	_lcd_send_command_4_bit(cmd >> 4);
-	/* Low nibble */
-	_lcd_send_command_4_bit(cmd & 0x0F);
+	_lcd_transport.send(cmd, 0);
+	
+	/* Track LCD address counter */
+	if (cmd & LCD_SETDDRAMADDR) {
+		_lcd->options.Address = cmd & 0x7F;
+	}
+	else if (cmd & LCD_SETCGRAMADDR) {
+		_lcd->options.Address = LCD_ADDRESS_UNKNOWN;	// counter points to CGRAM
+	}
+	else if (cmd < LCD_ENTRYMODESET) {
+		_lcd->options.Address = 0;	// clear, home
+	}
+	else if (((cmd & 0xF0) == LCD_CURSORSHIFT) && !(cmd & LCD_DISPLAYMOVE)) {
+		_lcd->options.Address = LCD_ADDRESS_UNKNOWN;	// cursor move
+	}
 }
 
 void _lcd_send_data(uint8_t data) {
-	/* Data mode */
-	GPIO_SetBits(LCD_RS_Port, LCD_RS_Pin);
+	_lcd_transport.send(data, 1);
+	_lcd_address_advance(1);
+}
+
+/* Data bytes: one transfer if transport supports it */
+void _lcd_send_data_run(const uint8_t* data, uint8_t length) {
+	_lcd_address_advance(length);
+	if (_lcd_transport.send_run) {
+		_lcd_transport.send_run(data, length);
+		return;
+	}
+	while (length--) {
+		_lcd_transport.send(*data++, 1);
+	}
+}
+
+/* Address counter after data write: unknown past end of DDRAM line (next line or wrap, depends on LCD) */
+static void _lcd_address_advance(uint8_t length) {
+	if (_lcd->options.Address == LCD_ADDRESS_UNKNOWN) {
+		return;
+	}
+	if (((_lcd->options.Address & 0x3F) + length) >= LCD_LINE_LENGTH) {
+		_lcd->options.Address = LCD_ADDRESS_UNKNOWN;
+	}
+	else {
+		_lcd->options.Address += length;
+	}
+}
+
+/* Write decimal number in front of end, at least digits characters (leading zeros). Returns first character */
+static char* _lcd_format_number(char* end, uint32_t number, uint8_t digits) {
+	uint32_t _number;
+	
+	do {
+		_number = number;
+		number /= 10;
+		*--end = '0' + (_number - 10 * number);	// residue
+		if (digits) {
+			digits--;
+		}
+	} while (number || digits);
 	
-	/* High nibble */
-	_lcd_send_command_4_bit(data >> 4);
-	/* Low nibble */
-	_lcd_send_command_4_bit(data & 0x0F);
+	return end;
 }
 
 void _lcd_send_command_4_bit(uint8_t cmd) {
-	/* Set output port */
-	GPIO_WriteBit(LCD_D7_Port, LCD_D7_Pin, (BitAction) (cmd & 0x08));
-	GPIO_WriteBit(LCD_D6_Port, LCD_D6_Pin, (BitAction) (cmd & 0x04));
-	GPIO_WriteBit(LCD_D5_Port, LCD_D5_Pin, (BitAction) (cmd & 0x02));
-	GPIO_WriteBit(LCD_D4_Port, LCD_D4_Pin, (BitAction) (cmd & 0x01));
+	#ifdef LCD_USE_8BIT
+		_lcd_put_byte(cmd << 4, 0);	// power on sequence: DB4-DB7, DB0-DB3 don't care
+	#else
+		_lcd_put_nibble(cmd, 0);
+	#endif
 	_lcd_enable_pulse();
 }
 
-void _lcd_cursor_set(uint8_t row, uint8_t col){
-	uint8_t row_offsets[] = {0x00, 0x40, 0x14, 0x54};
+#ifndef LCD_USE_I2C
+/* GPIO transport: shared pins (first display), E pin, then at least 40ms power on delay */
+static void _lcd_gpio_init(void) {
+	if (_lcd_bus_ready == 0) {
+		_lcd_bus_ready = 1;
+		_lcd_init_pins();
+		#ifdef LCD_USE_ASYNC
+			_lcd_async_init();
+		#endif
+	}
+	/*Configure GPIO pin EN */
+	gpio_pinSetup(_lcd->E_Port, _lcd->E_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	GPIO_ResetBits(_lcd->E_Port, _lcd->E_Pin);
+	#ifdef LCD_USE_ASYNC
+		_lcd_queue_push(LCD_QUEUE_DELAY | LCD_QUEUE_WAIT_50MS);
+	#else
+		delay(50);
+	#endif
+}
+
+/* Power on sequence: single nibble, then 5 ms (long_wait) or 100 us */
+static void _lcd_gpio_send_init_nibble(uint8_t nibble, uint8_t long_wait) {
+	#ifdef LCD_USE_ASYNC
+		if (long_wait) {
+			_lcd_queue_push(LCD_QUEUE_NIBBLE | LCD_QUEUE_WAIT_5MS | nibble);
+		}
+		else {
+			_lcd_queue_push(LCD_QUEUE_NIBBLE | nibble);
+		}
+	#else
+		_lcd_send_command_4_bit(nibble);
+		if (long_wait) {
+			delay(5);
+		}
+		else {
+			delay_us(100);
+		}
+	#endif
+}
+
+/* GPIO transport: command (rs = 0) or data (rs = 1) */
+static void _lcd_gpio_send(uint8_t byte, uint8_t rs) {
+	#ifdef LCD_USE_ASYNC
+		if (rs) {
+			_lcd_queue_push(LCD_QUEUE_RS | byte);
+		}
+		else if (byte < LCD_ENTRYMODESET) {
+			_lcd_queue_push(LCD_QUEUE_WAIT_2MS | byte);	// clear, home
+		}
+		else {
+			_lcd_queue_push(byte);
+		}
+		return;
+	#endif
+	_lcd_wait_busy();	// previous transfer to this display: transfers to other displays overlap it
+	#ifdef LCD_USE_8BIT
+		_lcd_put_byte(byte, rs);
+		_lcd_enable_pulse();
+	#else
+		/* High nibble */
+		_lcd_put_nibble(byte >> 4, rs);
+		_lcd_enable_pulse();
+		/* Low nibble */
+		_lcd_put_nibble(byte & 0x0F, rs);
+		_lcd_enable_pulse();
+	#endif
+	
+	if (_lcd->options.BusyFlag == 0) {
+		// waited before next transfer to this display
+		if ((rs == 0) && (byte < LCD_ENTRYMODESET)) {
+			_lcd_settle(2000);	// clear, home: 1.52 ms
+		}
+		else {
+			_lcd_settle(LCD_EXEC_US);
+		}
+	}
+}
+#else
+/* 
+	I2C transport (PCF8574 backpack). Every byte written to expander sets all 8 pins, 
+	so one nibble is two bytes: E high with data, then E low (falling edge latches data).
+	Each transfer is sent by DMA with automatic STOP; 100 kHz-400 kHz bus is slower than LCD, no delays needed.
+*/
+static void _lcd_i2c_init(void) {
+	DMA_InitTypeDef DMA_InitStruct;
+	I2C_InitTypeDef I2C_InitStruct;
+	
+	if (_lcd_bus_ready) {	// other display (backpack) on the same bus
+		delay(50);
+		return;
+	}
+	_lcd_bus_ready = 1;
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	RCC_APB1PeriphClockCmd(LCD_I2C_RCC, ENABLE);
+	RCC_I2CCLKConfig(RCC_I2C1CLK_HSI);	// timing doesn't depend on system clock
+	
+	gpio_pinSetup_AF(LCD_I2C_SCL_Port, LCD_I2C_SCL_Pin, LCD_I2C_AF, GPIO_OType_OD, GPIO_PuPd_UP, GPIO_Speed_Level_2);
+	gpio_pinSetup_AF(LCD_I2C_SDA_Port, LCD_I2C_SDA_Pin, LCD_I2C_AF, GPIO_OType_OD, GPIO_PuPd_UP, GPIO_Speed_Level_2);
+	
+	I2C_StructInit(&I2C_InitStruct);
+	I2C_InitStruct.I2C_Mode = I2C_Mode_I2C;
+	I2C_InitStruct.I2C_AnalogFilter = I2C_AnalogFilter_Enable;
+	I2C_InitStruct.I2C_DigitalFilter = 0;
+	I2C_InitStruct.I2C_Ack = I2C_Ack_Enable;
+	I2C_InitStruct.I2C_AcknowledgedAddress = I2C_AcknowledgedAddress_7bit;
+	I2C_InitStruct.I2C_Timing = LCD_I2C_TIMING;
+	I2C_Init(LCD_I2C, &I2C_InitStruct);
+	I2C_DMACmd(LCD_I2C, I2C_DMAReq_Tx, ENABLE);
+	I2C_Cmd(LCD_I2C, ENABLE);
+	
+	DMA_StructInit(&DMA_InitStruct);
+	DMA_InitStruct.DMA_PeripheralBaseAddr = (uint32_t)&LCD_I2C->TXDR;
+	DMA_InitStruct.DMA_MemoryBaseAddr = (uint32_t)_lcd_i2c_buffer;
+	DMA_InitStruct.DMA_DIR = DMA_DIR_PeripheralDST;
+	DMA_InitStruct.DMA_BufferSize = 1;
+	DMA_InitStruct.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStruct.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStruct.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStruct.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStruct.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStruct.DMA_Priority = DMA_Priority_Low;
+	DMA_InitStruct.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(LCD_I2C_DMA_Channel, &DMA_InitStruct);
+	
+	delay(50);	// at least 40ms after power on
+}
+
+/* 
+	Wait for end of previous transfer (STOP sent), then buffer can be refilled.
+	Bus error, arbitration lost (noise, SDA held low) or no STOP in LCD_I2C_TIMEOUT_MS: DMA is aborted and
+	I2C peripheral is reset (PE cleared), transfer is lost but next one starts on clean bus.
+*/
+static void _lcd_i2c_wait(void) {
+	uint32_t start_ms;
+	
+	if (_lcd_i2c_busy == 0) {
+		return;
+	}
+	start_ms = millis();
+	while (I2C_GetFlagStatus(LCD_I2C, I2C_FLAG_STOPF) == RESET) {
+		if ((I2C_GetFlagStatus(LCD_I2C, I2C_FLAG_BERR) != RESET) || (I2C_GetFlagStatus(LCD_I2C, I2C_FLAG_ARLO) != RESET) || 
+				((millis() - start_ms) > LCD_I2C_TIMEOUT_MS)) {
+			DMA_Cmd(LCD_I2C_DMA_Channel, DISABLE);
+			I2C_Cmd(LCD_I2C, DISABLE);	// software reset: releases SCL, SDA, clears state machine
+			I2C_ClearFlag(LCD_I2C, I2C_FLAG_BERR | I2C_FLAG_ARLO);
+			I2C_Cmd(LCD_I2C, ENABLE);	// PE must be low for 3 APB cycles: function calls take longer
+			break;
+		}
+	}
+	I2C_ClearFlag(LCD_I2C, I2C_FLAG_STOPF | I2C_FLAG_NACKF);	// NACK: no backpack, transfer is lost
+	DMA_Cmd(LCD_I2C_DMA_Channel, DISABLE);
+	_lcd_i2c_busy = 0;
+}
+
+/* Start DMA transfer of _lcd_i2c_buffer, returns immediately */
+static void _lcd_i2c_start(void) {
+	DMA_SetCurrDataCounter(LCD_I2C_DMA_Channel, _lcd_i2c_length);
+	DMA_Cmd(LCD_I2C_DMA_Channel, ENABLE);
+	I2C_TransferHandling(LCD_I2C, _lcd->I2C_Address << 1, _lcd_i2c_length, I2C_AutoEnd_Mode, I2C_Generate_Start_Write);
+	_lcd_i2c_busy = 1;
+}
+
+/* Append one nibble (upper 4 bits of value): E pulse */
+static void _lcd_i2c_put_nibble(uint8_t value, uint8_t ctrl) {
+	value = (value & 0xF0) | ctrl;
+	_lcd_i2c_buffer[_lcd_i2c_length++] = value | LCD_I2C_E;
+	_lcd_i2c_buffer[_lcd_i2c_length++] = value;
+}
+
+/* New transfer: first byte sets RS with E low */
+static uint8_t _lcd_i2c_begin(uint8_t rs) {
+	uint8_t ctrl = (_lcd->options.Backlight ? LCD_I2C_BACKLIGHT : 0) | (rs ? LCD_I2C_RS : 0);
 	
+	_lcd_i2c_wait();
+	_lcd_i2c_buffer[0] = ctrl;
+	_lcd_i2c_length = 1;
+	return ctrl;
+}
+
+static void _lcd_i2c_send_init_nibble(uint8_t nibble, uint8_t long_wait) {
+	_lcd_i2c_put_nibble(nibble << 4, _lcd_i2c_begin(0));
+	_lcd_i2c_start();
+	_lcd_i2c_wait();
+	if (long_wait) {
+		delay(5);
+	}
+	else {
+		delay_us(100);
+	}
+}
+
+static void _lcd_i2c_send(uint8_t byte, uint8_t rs) {
+	uint8_t ctrl = _lcd_i2c_begin(rs);
+	
+	_lcd_i2c_put_nibble(byte, ctrl);
+	_lcd_i2c_put_nibble(byte << 4, ctrl);
+	_lcd_i2c_start();
+	if ((rs == 0) && (byte < LCD_ENTRYMODESET)) {
+		_lcd_i2c_wait();
+		delay(3);	// clear, home
+	}
+}
+
+/* Data bytes: up to (LCD_I2C_BUFFER_SIZE - 1) / 4 characters per transfer */
+static void _lcd_i2c_send_run(const uint8_t* data, uint8_t length) {
+	uint8_t ctrl;
+	
+	while (length) {
+		ctrl = _lcd_i2c_begin(1);
+		while (length && (_lcd_i2c_length <= (LCD_I2C_BUFFER_SIZE - 4))) {
+			_lcd_i2c_put_nibble(*data, ctrl);
+			_lcd_i2c_put_nibble(*data << 4, ctrl);
+			data++;
+			length--;
+		}
+		_lcd_i2c_start();
+	}
+}
+#endif
+
+/* Set data pins and RS (0 - command, 1 - data): single BSRR store per port */
+void _lcd_put_nibble(uint8_t nibble, uint8_t rs) {
+	_lcd_port_t* p = _lcd_ports;
+	_lcd_port_t* end = &_lcd_ports[_lcd_port_count];
+	
+	rs = (rs != 0);
+	do {
+		p->port->BSRR = p->nibble_bsrr[nibble] | p->rs_bsrr[rs];
+		p++;
+	} while (p < end);
+}
+
+#ifdef LCD_USE_8BIT
+/* 8-bit interface: set data pins and RS (0 - command, 1 - data) */
+void _lcd_put_byte(uint8_t byte, uint8_t rs) {
+	_lcd_port_t* p = _lcd_ports;
+	_lcd_port_t* end = &_lcd_ports[_lcd_port_count];
+	
+	rs = (rs != 0);
+	if (_lcd_bus_shift != LCD_BUS_NOT_CONTIGUOUS) {
+		// D0-D7 consecutive: set byte bits, reset complement bits
+		p->port->BSRR = ((uint32_t)byte << _lcd_bus_shift) | ((uint32_t)(byte ^ 0xFF) << (_lcd_bus_shift + 16)) | p->rs_bsrr[rs];
+		p++;
+		if (p < end) {	// RS on other port
+			p->port->BSRR = p->rs_bsrr[rs];
+		}
+		return;
+	}
+	do {
+		p->port->BSRR = p->nibble_bsrr[byte >> 4] | p->low_bsrr[byte & 0x0F] | p->rs_bsrr[rs];
+		p++;
+	} while (p < end);
+}
+#endif
+
+/* 
+	Add pin to port table. bit: 0-7 = D0-D7, 8 = RS
+	Each BSRR value sets or resets every pin of the port, so the order of stores doesn't matter.
+*/
+static void _lcd_add_pin(GPIO_TypeDef* port, uint16_t pin, uint8_t bit) {
+	_lcd_port_t* p;
+	uint8_t i;
+	
+	for (i = 0; i < _lcd_port_count; i++) {
+		if (_lcd_ports[i].port == port) {
+			break;
+		}
+	}
+	p = &_lcd_ports[i];
+	if (i == _lcd_port_count) {	// new port
+		memset(p, 0, sizeof(_lcd_port_t));
+		p->port = port;
+		_lcd_port_count++;
+	}
+	
+	if (bit == 8) {
+		p->rs_bsrr[0] |= (uint32_t)pin << 16;
+		p->rs_bsrr[1] |= pin;
+		return;
+	}
+	for (i = 0; i < 16; i++) {
+		if (bit >= 4) {	// D4-D7
+			p->nibble_bsrr[i] |= (i & (1 << (bit - 4))) ? pin : ((uint32_t)pin << 16);
+		}
+		#ifdef LCD_USE_8BIT
+		else {	// D0-D3
+			p->low_bsrr[i] |= (i & (1 << bit)) ? pin : ((uint32_t)pin << 16);
+		}
+		#endif
+	}
+}
+
+#ifdef LCD_USE_FRAME_BUFFER
+/* 
+	Send next changed run (up to max characters) of selected display, from flush_order/flush_col on. 
+	Returns 0 if there are no more changes.
+*/
+static uint8_t _lcd_flush_run(uint8_t max) {
+	uint8_t row, col, end, next;
+	uint8_t address;
+	
+	while (_lcd->flush_order < 4) {
+		row = _lcd_flush_order[_lcd->flush_order];
+		if (row < _lcd->options.Rows) {
+			for (col = _lcd->flush_col; col < _lcd->options.Cols; col++) {
+				if (_lcd->frame[row][col] != _lcd->shown[row][col]) {
+					break;
+				}
+			}
+			if (col < _lcd->options.Cols) {
+				// changed run: [col, end), including gaps of up to LCD_FLUSH_GAP unchanged characters
+				end = col + 1;
+				for (next = end; (next < _lcd->options.Cols) && ((next - col) < max); next++) {
+					if (_lcd->frame[row][next] != _lcd->shown[row][next]) {
+						end = next + 1;
+					}
+					else if ((next - end) >= LCD_FLUSH_GAP) {
+						break;
+					}
+				}
+				
+				address = _lcd_row_offsets[row] + col;
+				if (address != _lcd->options.Address) {
+					_lcd_send_command(LCD_SETDDRAMADDR | address);
+				}
+				_lcd_send_data_run((uint8_t*)&_lcd->frame[row][col], end - col);
+				memcpy(&_lcd->shown[row][col], &_lcd->frame[row][col], end - col);
+				_lcd->flush_col = end;
+				return 1;
+			}
+		}
+		_lcd->flush_order++;
+		_lcd->flush_col = 0;
+	}
+	return 0;
+}
+#endif
+
+/* Remove marquee text, display shift = 0 */
+static void _lcd_marquee_reset(void) {
+	#ifdef LCD_USE_FRAME_BUFFER
+		if (_lcd->marquee_step % LCD_LINE_LENGTH) {
+			_lcd_send_command(LCD_RETURNHOME);	// frame buffer clear doesn't send clear command
+		}
+	#endif
+	memset(_lcd->marquee, 0, sizeof(_lcd->marquee));
+	_lcd->marquee_step = 0;
+	_lcd->marquee_ms = 0;
+}
+
+/* Write virtual line positions [from, to) of marquee row to DDRAM, to - from <= 40 */
+static void _lcd_marquee_write(uint8_t row, uint32_t from, uint32_t to) {
+	_lcd_marquee_t* m = &_lcd->marquee[row];
+	char buf[LCD_LINE_LENGTH];
+	uint8_t col, length;
+	uint16_t position;
+	
+	while (from < to) {
+		col = from % LCD_LINE_LENGTH;
+		position = from % m->period;
+		length = 0;
+		do {	// up to end of DDRAM line
+			buf[length++] = (position < m->length) ? m->text[position] : ' ';
+			if (++position == m->period) {
+				position = 0;
+			}
+			from++;
+		} while ((from < to) && ((col + length) < LCD_LINE_LENGTH));
+		
+		if ((_lcd_row_offsets[row] + col) != _lcd->options.Address) {
+			_lcd_send_command(LCD_SETDDRAMADDR | (_lcd_row_offsets[row] + col));
+		}
+		_lcd_send_data_run((uint8_t*)buf, length);
+	}
+}
+
+/* Write bitmap to CGRAM slot, skipped if slot already has it */
+static void _lcd_glyph_upload(uint8_t slot, const uint8_t* bitmap) {
+	if ((_lcd->glyph_loaded & (1 << slot)) && (memcmp(_lcd->glyph_bitmap[slot], bitmap, 8) == 0)) {
+		return;
+	}
+	_lcd_send_command(LCD_SETCGRAMADDR | (slot << 3));
+	_lcd_send_data_run(bitmap, 8);
+	memcpy(_lcd->glyph_bitmap[slot], bitmap, 8);
+	_lcd->glyph_loaded |= (1 << slot);
+}
+
+/* Move slot to front of LRU list */
+static void _lcd_glyph_touch(uint8_t slot) {
+	uint8_t i = 0;
+	
+	while (_lcd->glyph_lru[i] != slot) {
+		i++;
+	}
+	for (; i > 0; i--) {
+		_lcd->glyph_lru[i] = _lcd->glyph_lru[i - 1];
+	}
+	_lcd->glyph_lru[0] = slot;
+}
+
+void _lcd_cursor_set(uint8_t row, uint8_t col){
 	/* Go to beginning */
-	if (row >= _lcd_options.Rows) {
+	if (row >= _lcd->options.Rows) {
 		row = 0;
 	}
 	
-	/* Set current column and row */
-	_lcd_options.currentX = col;
-	_lcd_options.currentY = row;
+	/* Set current column and row, address is set before next character (_lcd_cursor_sync) */
+	_lcd->options.currentX = col;
+	_lcd->options.currentY = row;
+}
+
+/* Set location address, only if LCD address counter is not already there */
+void _lcd_cursor_sync(void) {
+	uint8_t address = _lcd->options.currentX + _lcd_row_offsets[_lcd->options.currentY];
 	
-	/* Set location address */
-	_lcd_send_command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+	if (address != _lcd->options.Address) {
+		_lcd_send_command(LCD_SETDDRAMADDR | address);
+	}
 }
 
+uint8_t LCD_Idle(void) {
+	#ifdef LCD_USE_ASYNC
+		return (_lcd_async_busy == 0);
+	#else
+		return 1;
+	#endif
+}
+
+/* Put character on current cursor position (or in frame buffer) */
+void _lcd_put_char(char c){
+	#ifdef LCD_USE_FRAME_BUFFER
+		if ((_lcd->options.currentY < _lcd->options.Rows) && (_lcd->options.currentX < _lcd->options.Cols)) {
+			_lcd->frame[_lcd->options.currentY][_lcd->options.currentX] = c;
+		}
+	#else
+		_lcd_cursor_sync();
+		_lcd_send_data(c);
+	#endif
+	_lcd->options.currentX++;
+}
+
+/* Characters at cursor: one data transfer (I2C) instead of one per character */
+void _lcd_put_chars(const char* str, uint8_t length) {
+	#ifdef LCD_USE_FRAME_BUFFER
+		while (length--) {
+			_lcd_put_char(*str++);
+		}
+	#else
+		_lcd_cursor_sync();
+		_lcd_send_data_run((const uint8_t*)str, length);
+		_lcd->options.currentX += length;
+	#endif
+}
+
+/* Shared pins: RS, RW, data. E pin of each display is configured in _lcd_gpio_init() */
 void _lcd_init_pins(void) {
-	/*Configure GPIO pin EN */
-	gpio_pinSetup(LCD_E_Port, LCD_E_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
   /*Configure GPIO pin RS */
   gpio_pinSetup(LCD_RS_Port, LCD_RS_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	#ifdef LCD_USE_BUSY_FLAG
+		/*Configure GPIO pin RW */
+		gpio_pinSetup(LCD_RW_Port, LCD_RW_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		GPIO_ResetBits(LCD_RW_Port, LCD_RW_Pin);	// write
+	#endif
 	/*Configure GPIO pin DB4 */
   gpio_pinSetup(LCD_D4_Port, LCD_D4_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
 	/*Configure GPIO pin DB5 */
@@ -294,19 +1195,338 @@ void _lcd_init_pins(void) {
   gpio_pinSetup(LCD_D6_Port, LCD_D6_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
 	/*Configure GPIO pin DB7 */
   gpio_pinSetup(LCD_D7_Port, LCD_D7_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	#ifdef LCD_USE_8BIT
+		/*Configure GPIO pins DB0 - DB3 */
+		gpio_pinSetup(LCD_D0_Port, LCD_D0_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		gpio_pinSetup(LCD_D1_Port, LCD_D1_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		gpio_pinSetup(LCD_D2_Port, LCD_D2_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		gpio_pinSetup(LCD_D3_Port, LCD_D3_Pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	#endif
 	  	
 	// GPIO initial state
-	GPIO_ResetBits(LCD_E_Port, LCD_E_Pin);
 	GPIO_ResetBits(LCD_RS_Port, LCD_RS_Pin);
 	GPIO_ResetBits(LCD_D4_Port, LCD_D4_Pin);
 	GPIO_ResetBits(LCD_D5_Port, LCD_D5_Pin);
 	GPIO_ResetBits(LCD_D6_Port, LCD_D6_Pin);
 	GPIO_ResetBits(LCD_D7_Port, LCD_D7_Pin);
+	
+	// nibble tables
+	_lcd_port_count = 0;
+	#ifdef LCD_USE_8BIT
+		_lcd_add_pin(LCD_D0_Port, LCD_D0_Pin, 0);
+		_lcd_add_pin(LCD_D1_Port, LCD_D1_Pin, 1);
+		_lcd_add_pin(LCD_D2_Port, LCD_D2_Pin, 2);
+		_lcd_add_pin(LCD_D3_Port, LCD_D3_Pin, 3);
+	#endif
+	_lcd_add_pin(LCD_D4_Port, LCD_D4_Pin, 4);
+	_lcd_add_pin(LCD_D5_Port, LCD_D5_Pin, 5);
+	_lcd_add_pin(LCD_D6_Port, LCD_D6_Pin, 6);
+	_lcd_add_pin(LCD_D7_Port, LCD_D7_Pin, 7);
+	_lcd_add_pin(LCD_RS_Port, LCD_RS_Pin, 8);
+	
+	#ifdef LCD_USE_8BIT
+		// D0-D7 consecutive pins of one port (_lcd_ports[0]): byte is shifted into BSRR
+		_lcd_bus_shift = 0;
+		while ((LCD_D0_Pin >> _lcd_bus_shift) != 1) {
+			_lcd_bus_shift++;
+		}
+		if (((_lcd_ports[0].nibble_bsrr[0x0F] & 0xFFFF) != ((uint32_t)0xF0 << _lcd_bus_shift)) || 
+				((_lcd_ports[0].low_bsrr[0x0F] & 0xFFFF) != ((uint32_t)0x0F << _lcd_bus_shift))) {
+			_lcd_bus_shift = LCD_BUS_NOT_CONTIGUOUS;
+		}
+	#endif
 }
 
 void _lcd_enable_pulse(void){
-	GPIO_SetBits(LCD_E_Port, LCD_E_Pin);
+	_lcd_settle_wait();	// execution time of previous transfer
+	reg_gpioSet(_lcd->E_Port, _lcd->E_Pin);
 	delay_us(2);
-	GPIO_ResetBits(LCD_E_Port, LCD_E_Pin);
-	delay_us(100);
+	reg_gpioReset(_lcd->E_Port, _lcd->E_Pin);
+}
+
+/* Selected display executes last transfer for us microseconds (busy flag is not used) */
+static void _lcd_settle(uint16_t us) {
+	_lcd->settle_tick = SysTick->VAL;
+	_lcd->settle_ms = millis();
+	_lcd->settle_us = us;
+}
+
+/* Wait until selected display executed last transfer. SysTick counts down from LOAD to 0 each millisecond */
+static void _lcd_settle_wait(void) {
+	uint32_t now, elapsed;
+	
+	if (_lcd->settle_us == 0) {
+		return;
+	}
+	if (_lcd->settle_us >= 1000) {
+		while ((millis() - _lcd->settle_ms) <= (_lcd->settle_us / 1000));	// + partial first millisecond
+	}
+	else {
+		while ((millis() - _lcd->settle_ms) < 2) {	// 2 ms: executed for sure
+			now = SysTick->VAL;
+			elapsed = (now <= _lcd->settle_tick) ? (_lcd->settle_tick - now) : (_lcd->settle_tick + SysTick->LOAD + 1 - now);
+			if (elapsed >= (_lcd->settle_us * _lcd_ticks_per_us)) {
+				break;
+			}
+		}
+	}
+	_lcd->settle_us = 0;
+}
+
+#ifdef LCD_USE_BUSY_FLAG
+/* Set pin mode directly in MODER: faster than GPIO_Init(), used twice per byte */
+static void _lcd_pin_mode(GPIO_TypeDef* port, uint16_t pin, uint32_t mode) {
+	uint8_t pos = 0;
+	
+	while ((pin & (1 << pos)) == 0) {
+		pos++;
+	}
+	port->MODER = (port->MODER & ~(0x03 << (pos * 2))) | (mode << (pos * 2));
+}
+
+/* Set pin pull-up/pull-down directly in PUPDR */
+static void _lcd_pin_pull(GPIO_TypeDef* port, uint16_t pin, uint32_t pull) {
+	uint8_t pos = 0;
+	
+	while ((pin & (1 << pos)) == 0) {
+		pos++;
+	}
+	port->PUPDR = (port->PUPDR & ~(0x03 << (pos * 2))) | (pull << (pos * 2));
+}
+
+/* Data pins to input (read) or output (write) */
+static void _lcd_data_pins_mode(uint32_t mode) {
+	_lcd_pin_mode(LCD_D4_Port, LCD_D4_Pin, mode);
+	_lcd_pin_mode(LCD_D5_Port, LCD_D5_Pin, mode);
+	_lcd_pin_mode(LCD_D6_Port, LCD_D6_Pin, mode);
+	_lcd_pin_mode(LCD_D7_Port, LCD_D7_Pin, mode);
+	#ifdef LCD_USE_8BIT
+		_lcd_pin_mode(LCD_D0_Port, LCD_D0_Pin, mode);
+		_lcd_pin_mode(LCD_D1_Port, LCD_D1_Pin, mode);
+		_lcd_pin_mode(LCD_D2_Port, LCD_D2_Pin, mode);
+		_lcd_pin_mode(LCD_D3_Port, LCD_D3_Pin, mode);
+	#endif
+}
+#endif
+
+#ifdef LCD_USE_BUSY_FLAG
+/* 
+	Data pins to input, read instruction register. DB7 is pulled up: not driven by LCD it reads "busy" (timeout).
+	Other data pins are pulled down: if R/W is not connected, each read is a write of "set DDRAM address" (0x88).
+*/
+static void _lcd_read_begin(void) {
+	_lcd_data_pins_mode(GPIO_Mode_IN);
+	_lcd_pin_pull(LCD_D4_Port, LCD_D4_Pin, GPIO_PuPd_DOWN);
+	_lcd_pin_pull(LCD_D5_Port, LCD_D5_Pin, GPIO_PuPd_DOWN);
+	_lcd_pin_pull(LCD_D6_Port, LCD_D6_Pin, GPIO_PuPd_DOWN);
+	_lcd_pin_pull(LCD_D7_Port, LCD_D7_Pin, GPIO_PuPd_UP);
+	#ifdef LCD_USE_8BIT
+		_lcd_pin_pull(LCD_D0_Port, LCD_D0_Pin, GPIO_PuPd_DOWN);
+		_lcd_pin_pull(LCD_D1_Port, LCD_D1_Pin, GPIO_PuPd_DOWN);
+		_lcd_pin_pull(LCD_D2_Port, LCD_D2_Pin, GPIO_PuPd_DOWN);
+		_lcd_pin_pull(LCD_D3_Port, LCD_D3_Pin, GPIO_PuPd_DOWN);
+	#endif
+	reg_gpioReset(LCD_RS_Port, LCD_RS_Pin);	// instruction register: busy flag + address
+	reg_gpioSet(LCD_RW_Port, LCD_RW_Pin);		// read
+}
+
+static void _lcd_read_end(void) {
+	reg_gpioReset(LCD_RW_Port, LCD_RW_Pin);	// write
+	_lcd_pin_pull(LCD_D4_Port, LCD_D4_Pin, GPIO_PuPd_NOPULL);
+	_lcd_pin_pull(LCD_D5_Port, LCD_D5_Pin, GPIO_PuPd_NOPULL);
+	_lcd_pin_pull(LCD_D6_Port, LCD_D6_Pin, GPIO_PuPd_NOPULL);
+	_lcd_pin_pull(LCD_D7_Port, LCD_D7_Pin, GPIO_PuPd_NOPULL);
+	#ifdef LCD_USE_8BIT
+		_lcd_pin_pull(LCD_D0_Port, LCD_D0_Pin, GPIO_PuPd_NOPULL);
+		_lcd_pin_pull(LCD_D1_Port, LCD_D1_Pin, GPIO_PuPd_NOPULL);
+		_lcd_pin_pull(LCD_D2_Port, LCD_D2_Pin, GPIO_PuPd_NOPULL);
+		_lcd_pin_pull(LCD_D3_Port, LCD_D3_Pin, GPIO_PuPd_NOPULL);
+	#endif
+	_lcd_data_pins_mode(GPIO_Mode_OUT);
+}
+
+/* One read of instruction register, returns busy flag (DB7) */
+static uint8_t _lcd_read_busy(void) {
+	uint8_t busy;
+	
+	/* High nibble: busy flag on DB7 */
+	reg_gpioSet(_lcd->E_Port, _lcd->E_Pin);
+	delay_us(1);
+	busy = reg_gpioRead(LCD_D7_Port, LCD_D7_Pin);
+	reg_gpioReset(_lcd->E_Port, _lcd->E_Pin);
+	delay_us(1);
+	#ifndef LCD_USE_8BIT
+		/* Low nibble: address, ignored */
+		reg_gpioSet(_lcd->E_Port, _lcd->E_Pin);
+		delay_us(1);
+		reg_gpioReset(_lcd->E_Port, _lcd->E_Pin);
+		delay_us(1);
+	#endif
+	return busy;
+}
+
+#ifndef LCD_USE_ASYNC
+/* 
+	Called by LCD_Init() right after clear command (sent with fixed delays): R/W is connected if busy flag 
+	is set while clear is executed (1.52 ms) and cleared after it. Otherwise busy flag is never read again 
+	(E is not strobed in read mode) and clear is repeated, because reads were writes of instruction 0x88.
+*/
+static void _lcd_busy_check(void) {
+	uint8_t busy, ready;
+	
+	_lcd_read_begin();
+	busy = _lcd_read_busy();
+	_lcd_read_end();
+	_lcd_settle_wait();	// clear executed
+	_lcd_read_begin();
+	ready = !_lcd_read_busy();
+	_lcd_read_end();
+	
+	if (busy && ready) {
+		_lcd->options.BusyFlag = 1;
+	}
+	else {
+		_lcd_settle(LCD_EXEC_US);
+		_lcd_send_command(LCD_CLEARDISPLAY);
+	}
+}
+#endif
+#endif
+
+/*
+	Busy flag mode: read DB7 until LCD is ready. Returns as soon as the command is executed (~40us) instead 
+	of fixed delays. If busy flag is not cleared in LCD_BUSY_TIMEOUT_US (LCD disconnected, ...) fixed delays 
+	are used from now on.
+*/
+void _lcd_wait_busy(void) {
+	#ifdef LCD_USE_BUSY_FLAG
+		uint32_t timeout = LCD_BUSY_TIMEOUT_US / 4;	// one read takes at least 4 us
+		uint8_t busy;
+		
+		if (_lcd->options.BusyFlag == 0) {
+			return;
+		}
+		_lcd_read_begin();
+		do {
+			busy = _lcd_read_busy();
+			timeout--;
+		} while (busy && timeout);
+		_lcd_read_end();
+		
+		if (busy) {
+			_lcd->options.BusyFlag = 0;	// no response, fall back to fixed delays
+		}
+	#endif
+}
+
+#ifdef LCD_USE_ASYNC
+/* LCD_TIM: 1 us resolution, update interrupt after each step of transfer */
+static void _lcd_async_init(void) {
+	TIM_TimeBaseInitTypeDef lcd_timer;
+	RCC_ClocksTypeDef system_freq;
+	NVIC_InitTypeDef lcd_timer_int;
+	
+	RCC_GetClocksFreq(&system_freq);	//get system clocks
+	
+	RCC_APB1PeriphClockCmd(LCD_TIM_RCC, ENABLE);
+	lcd_timer.TIM_Prescaler = (system_freq.HCLK_Frequency / 1000000) - 1;	// 1us timer increment
+	lcd_timer.TIM_CounterMode = TIM_CounterMode_Up;
+	lcd_timer.TIM_Period = 1;
+	lcd_timer.TIM_ClockDivision = TIM_CKD_DIV1;
+	lcd_timer.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(LCD_TIM, &lcd_timer);
+	
+	lcd_timer_int.NVIC_IRQChannel = LCD_TIM_IRQn;
+	lcd_timer_int.NVIC_IRQChannelPriority = 3;	// lowest: LCD timings are minimum values
+	lcd_timer_int.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&lcd_timer_int);
+	
+	TIM_ClearITPendingBit(LCD_TIM, TIM_IT_Update);
+	TIM_ITConfig(LCD_TIM, TIM_IT_Update, ENABLE);
+	TIM_Cmd(LCD_TIM, DISABLE);
+}
+
+/* Add entry to queue (wait if queue is full) and start timer if idle */
+static void _lcd_queue_push(uint16_t entry) {
+	while (atomic_ringFull(&_lcd_queue_ring));	// queue full
+	_lcd_queue[atomic_ringHead(&_lcd_queue_ring)] = entry | ((_lcd->index - 1) << LCD_QUEUE_DISPLAY_POS);
+	atomic_ringPush(&_lcd_queue_ring);
+	
+	// timer is stopped only by interrupt routine with empty queue, so entry is not left in queue
+	if (_lcd_async_busy == 0) {
+		_lcd_async_busy = 1;
+		_lcd_async_state = LCD_ASYNC_NEXT;
+		reg_timSetPeriod(LCD_TIM, 1);
+		reg_timSetCounter(LCD_TIM, 0);
+		reg_timStart(LCD_TIM);
+	}
+}
+
+/*
+	Transfer state machine: 
+	NEXT (nibble, E high) -> E_LOW -> SECOND (nibble, E high) -> E_LOW_LAST -> wait execution time -> NEXT
+*/
+void LCD_TIM_IRQHandler(void) {
+	uint16_t entry;
+	
+	if (reg_timUpdatePending(LCD_TIM)) {
+		reg_timClearUpdate(LCD_TIM);
+		
+		switch (_lcd_async_state) {
+			case LCD_ASYNC_NEXT:
+				if (atomic_ringEmpty(&_lcd_queue_ring)) {	// all sent
+					reg_timStop(LCD_TIM);
+					_lcd_async_busy = 0;
+					return;
+				}
+				entry = _lcd_queue[atomic_ringTail(&_lcd_queue_ring)];
+				atomic_ringPop(&_lcd_queue_ring);
+				_lcd_async_entry = entry;
+				_lcd_async_lcd = _lcd_displays[entry >> LCD_QUEUE_DISPLAY_POS];
+				if (entry & LCD_QUEUE_DELAY) {
+					reg_timSetPeriod(LCD_TIM, _lcd_async_wait_us[(entry >> LCD_QUEUE_WAIT_POS) & 0x03] - 1);
+					return;
+				}
+				#ifdef LCD_USE_8BIT
+					if (entry & LCD_QUEUE_NIBBLE) {
+						_lcd_put_byte((entry & 0x0F) << 4, 0);
+					}
+					else {
+						_lcd_put_byte(entry & 0xFF, (entry & LCD_QUEUE_RS) != 0);
+					}
+					_lcd_async_state = LCD_ASYNC_E_LOW_LAST;	// whole byte with one enable pulse
+				#else
+					if (entry & LCD_QUEUE_NIBBLE) {
+						_lcd_put_nibble(entry & 0x0F, 0);
+						_lcd_async_state = LCD_ASYNC_E_LOW_LAST;
+					}
+					else {
+						_lcd_put_nibble((entry >> 4) & 0x0F, (entry & LCD_QUEUE_RS) != 0);
+						_lcd_async_state = LCD_ASYNC_E_LOW;
+					}
+				#endif
+				reg_gpioSet(_lcd_async_lcd->E_Port, _lcd_async_lcd->E_Pin);
+				reg_timSetPeriod(LCD_TIM, 1);
+				reg_timSetCounter(LCD_TIM, 0);	// counter may already be past new period (no ARR preload): would count to 0xFFFF
+				break;
+				
+			case LCD_ASYNC_E_LOW:
+				reg_gpioReset(_lcd_async_lcd->E_Port, _lcd_async_lcd->E_Pin);
+				_lcd_async_state = LCD_ASYNC_SECOND;
+				break;
+				
+			case LCD_ASYNC_SECOND:
+				_lcd_put_nibble(_lcd_async_entry & 0x0F, (_lcd_async_entry & LCD_QUEUE_RS) != 0);
+				reg_gpioSet(_lcd_async_lcd->E_Port, _lcd_async_lcd->E_Pin);
+				_lcd_async_state = LCD_ASYNC_E_LOW_LAST;
+				break;
+				
+			default:	// LCD_ASYNC_E_LOW_LAST
+				reg_gpioReset(_lcd_async_lcd->E_Port, _lcd_async_lcd->E_Pin);
+				reg_timSetPeriod(LCD_TIM, _lcd_async_wait_us[(_lcd_async_entry >> LCD_QUEUE_WAIT_POS) & 0x03] - 1);
+				_lcd_async_state = LCD_ASYNC_NEXT;
+				break;
+		}
+	}
 }
+#endif
@@ -12,21 +12,72 @@
 #include "stm32f0xx.h"
 #include "stm32f0xx_rcc.h"
 #include "stm32f0xx_gpio.h"
+#include "stm32f0xx_tim.h"
+#include "stm32f0xx_misc.h"
+#include "stm32f0xx_i2c.h"
+#include "stm32f0xx_dma.h"
 
 #include "stm32f0xx_gpio_init.h"
+#include "stm32f0xx_reg.h"
+#include "stm32f0xx_atomic.h"
 #include "delay_us.h"
 #include "systick_millis.h"
 
 #include "math.h"
 
+/* 
+	I2C backpack (PCF8574): LCD is connected through I2C port expander instead of GPIO pins. 
+	P0 = RS, P1 = RW, P2 = E, P3 = backlight, P4-P7 = D4-D7. Strings are sent with one I2C DMA transfer.
+	GPIO pin defines below are not used. Can't be used with LCD_USE_8BIT, LCD_USE_BUSY_FLAG, LCD_USE_ASYNC.
+*/
+//#define LCD_USE_I2C
+#define LCD_I2C								I2C1
+#define LCD_I2C_RCC						RCC_APB1Periph_I2C1
+#define LCD_I2C_ADDRESS				0x27				// PCF8574: 0x20-0x27, PCF8574A: 0x38-0x3F (7-bit)
+#define LCD_I2C_TIMING				0x00310309	// 400 kHz with 8 MHz HSI I2C clock (RM0360, I2C timing examples)
+#define LCD_I2C_SCL_Port			GPIOB
+#define LCD_I2C_SCL_Pin				GPIO_Pin_6
+#define LCD_I2C_SDA_Port			GPIOB
+#define LCD_I2C_SDA_Pin				GPIO_Pin_7
+#define LCD_I2C_AF						GPIO_AF_1
+#define LCD_I2C_DMA_Channel		DMA1_Channel2			// I2C1 TX
+#define LCD_I2C_BUFFER_SIZE		129					// 1 + 4 bytes per character: up to 32 characters per transfer
+#define LCD_I2C_TIMEOUT_MS		20					// longest transfer (129 bytes at 100 kHz) takes ~12 ms
+
 /* Register select*/
 #define LCD_RS_Port				GPIOB
 #define LCD_RS_Pin				GPIO_Pin_13
 
-/* Enable pin */
+/* Enable pin (default display) */
 #define LCD_E_Port				GPIOB
 #define LCD_E_Pin					GPIO_Pin_14
 
+/* 
+	Multiple displays: D4-D7 (D0-D7), RS and RW are shared, each display has its own E pin (lcd_struct).
+	Without busy flag, execution time of one display is waited only before next transfer to the same display,
+	so transfers to other displays overlap it. Async mode: one queue for all displays, timer paces every transfer.
+	I2C: each display has its own backpack (I2C_Address in lcd_struct).
+*/
+#define LCD_MAX_DISPLAYS	3		// max 8
+#define LCD_EXEC_US				100	// command/data execution time without busy flag
+
+/* Read/write pin (optional): busy flag (DB7) is polled instead of fixed delays. 
+	 Without LCD_USE_BUSY_FLAG connect R/W to GND. Note: 5V LCD - use 5V tolerant (FT) pins for D4-D7. 
+	 LCD_Init() checks that R/W is connected (busy flag set during clear), otherwise fixed delays are used. */
+//#define LCD_USE_BUSY_FLAG
+#define LCD_RW_Port				GPIOB
+#define LCD_RW_Pin				GPIO_Pin_12
+#define LCD_BUSY_TIMEOUT_US	4000		// busy flag not cleared in this time: switch to fixed delays
+
+/* Asynchronous mode: commands and data are queued and sent from timer interrupt, LCD functions don't wait */
+//#define LCD_USE_ASYNC
+#define LCD_QUEUE_SIZE			64		// number of queued bytes, must be power of 2
+#define LCD_ASYNC_EXEC_US		50		// command/data execution time (busy flag is not used in async mode)
+#define LCD_TIM							TIM6
+#define LCD_TIM_RCC					RCC_APB1Periph_TIM6
+#define LCD_TIM_IRQn				TIM6_IRQn							// STM32F051: TIM6_DAC_IRQn
+#define LCD_TIM_IRQHandler	TIM6_IRQHandler				// STM32F051: TIM6_DAC_IRQHandler
+
 /* Data pins */
 #define LCD_D4_Port				GPIOC
 #define LCD_D4_Pin				GPIO_Pin_8
@@ -40,8 +91,33 @@
 #define LCD_D7_Port				GPIOC
 #define LCD_D7_Pin				GPIO_Pin_6
 
+/* 8-bit interface: D0-D3 pins are also used, one enable pulse per byte. 
+	 If D0-D7 are consecutive pins of one port, byte is written with single shifted BSRR store. */
+//#define LCD_USE_8BIT
+#define LCD_D0_Port				GPIOC
+#define LCD_D0_Pin				GPIO_Pin_0
+
+#define LCD_D1_Port				GPIOC
+#define LCD_D1_Pin				GPIO_Pin_1
+
+#define LCD_D2_Port				GPIOC
+#define LCD_D2_Pin				GPIO_Pin_2
+
+#define LCD_D3_Port				GPIOC
+#define LCD_D3_Pin				GPIO_Pin_3
+
 //#define GO_TO_NEW_LINE_IF_STRING_TOO_LONG
 
+/* Frame buffer: LCD_Print...() functions only write to RAM, LCD_Flush() sends changed characters */
+//#define LCD_USE_FRAME_BUFFER
+#define LCD_FB_ROWS				4		// max rows and cols of frame buffer
+#define LCD_FB_COLS				20
+#define LCD_FLUSH_GAP			1		// unchanged characters between changes resent instead of new cursor set command
+
+/* Marquee: text longer than DDRAM line (40 characters) */
+#define LCD_MARQUEE_GAP			4		// spaces between end and start of text
+#define LCD_MARQUEE_REFILL	8		// off-screen characters refilled at once (max 40 - cols)
+
 /* Commands*/
 #define LCD_CLEARDISPLAY        0x01
 #define LCD_RETURNHOME          0x02
@@ -85,20 +161,121 @@ typedef struct {
 	uint8_t Cols;
 	uint8_t currentX;
 	uint8_t currentY;
+	uint8_t BusyFlag;		// 1: busy flag polling (LCD_USE_BUSY_FLAG), 0: fixed delays
+	uint8_t Backlight;	// I2C backpack: backlight bit of port expander
+	uint8_t Address;		// LCD DDRAM address counter (auto increment), LCD_ADDRESS_UNKNOWN after CGRAM write
 } _lcd_options_t;		// private LCD structure
 
+#define LCD_ADDRESS_UNKNOWN		0xFF
+
+/* Marquee row: text is mapped to endless virtual line, DDRAM line (40 characters) is a window of it */
+typedef struct {
+	const char* text;
+	uint16_t length;
+	uint16_t period;		// virtual line repeats: 40, or text + LCD_MARQUEE_GAP if text is longer than DDRAM line
+	uint32_t filled;		// virtual line is written to DDRAM up to this position
+} _lcd_marquee_t;
+
+/* Transport: how commands and data get to the LCD (GPIO pins or I2C backpack) */
+typedef struct {
+	void (*init)(void);																						// pins/peripheral and power on delay
+	void (*send_init_nibble)(uint8_t nibble, uint8_t long_wait);	// power on sequence: single nibble (RS = 0)
+	void (*send)(uint8_t byte, uint8_t rs);												// command (rs = 0) or data (rs = 1)
+	void (*send_run)(const uint8_t* data, uint8_t length);				// data bytes in one transfer, 0: send() is used
+} _lcd_transport_t;
+
+#define LCD_GLYPH_SLOTS			8		// CGRAM characters
+
+/* LCD display */
+typedef struct {
+	// user must define these variables (0: default display, LCD_E_Port/LCD_E_Pin, LCD_I2C_ADDRESS)
+	GPIO_TypeDef* E_Port;
+	uint16_t E_Pin;
+	uint8_t I2C_Address;	// I2C backpack: each display has its own backpack
+	
+	// private
+	_lcd_options_t options;
+	uint8_t index;								// in list of initialized displays + 1, 0: not initialized
+	uint16_t settle_us;						// execution time of last transfer, 0: ready
+	uint32_t settle_ms;						// millis() and SysTick value at last transfer
+	uint32_t settle_tick;
+	
+	uint8_t glyph_id[LCD_GLYPH_SLOTS];					// glyph ID in slot, LCD_GLYPH_NONE: free or LCD_CreateChar()
+	uint8_t glyph_bitmap[LCD_GLYPH_SLOTS][8];		// bitmap in CGRAM
+	uint8_t glyph_lru[LCD_GLYPH_SLOTS];					// slots, most recently used first
+	uint8_t glyph_loaded;												// bit mask: slot bitmap is known
+	uint8_t glyph_pinned;												// bit mask: LCD_CreateChar() slots
+	
+	_lcd_marquee_t marquee[2];		// rows 0 and 1 (DDRAM lines)
+	uint32_t marquee_step;				// display shifts = virtual line position of left column
+	uint16_t marquee_ms;					// step time, 0: stopped
+	uint32_t marquee_time;				// millis() of last step
+	
+	#ifdef LCD_USE_FRAME_BUFFER
+		char frame[LCD_FB_ROWS][LCD_FB_COLS];	// written by LCD_Print functions
+		char shown[LCD_FB_ROWS][LCD_FB_COLS];	// last flushed frame = LCD DDRAM content
+		uint8_t flush_order;									// LCD_FlushAll(): next row (index in flush order) and column
+		uint8_t flush_col;
+	#endif
+} lcd_struct;
+
+#if defined(LCD_USE_I2C) && (defined(LCD_USE_8BIT) || defined(LCD_USE_BUSY_FLAG) || defined(LCD_USE_ASYNC))
+	#error "LCD_USE_I2C: 8-bit, busy flag and async modes are not supported"
+#endif
+
+/*
+	Select display used by all other LCD functions (0: default display). 
+	Set E_Port and E_Pin of lcd before LCD_Init().
+*/
+void LCD_Select(lcd_struct* lcd);
+
 /*
 	Initializes LCD (HD44780)
 	rows: height of lcd
 	cols: width of lcd
+	Async mode: power on sequence is queued, function returns immediately.
+	Multiple displays: initializes selected display.
 */
 void LCD_Init(uint8_t rows, uint8_t cols);
+
+/* System clock changed: recalculate SysTick ticks per us (settle time) and LCD_TIM prescaler (register with clock_register()) */
+void LCD_ClockUpdate(const RCC_ClocksTypeDef* clocks);
 void LCD_PrintString(uint8_t y, uint8_t x, char* str);
 void LCD_PrintNumber(uint8_t y, uint8_t x, int32_t number);
 void LCD_PrintFloat(uint8_t y, uint8_t x, float number_f);
 
+/*
+	Streaming print: continues after last printed character.
+	Cursor command is sent only if next character is not at LCD address counter (auto increment),
+	numbers are formatted in RAM and sent as one data run.
+*/
+void LCD_SetCursor(uint8_t y, uint8_t x);
+void LCD_Write(const char* str);
+void LCD_WriteNumber(int32_t number);
+void LCD_WriteFloat(float number_f);
+
+/*
+	Async mode (LCD_USE_ASYNC): returns 1 when all queued commands and data are sent to LCD.
+	Blocking mode: always 1.
+*/
+uint8_t LCD_Idle(void);
+
+/*
+	Frame buffer (LCD_USE_FRAME_BUFFER): send characters that changed since last flush. 
+	Cursor set command is sent only where changed characters are not contiguous.
+	Without frame buffer: does nothing.
+*/
+void LCD_Flush(void);
+
+/*
+	Frame buffer: flush all initialized displays, one character per display in turn. 
+	Execution time of each display overlaps transfers to the others.
+*/
+void LCD_FlushAll(void);
+
 void LCD_DisplayOn(void);
 void LCD_DisplayOff(void);
+/* Clear display, also removes marquee text */
 void LCD_Clear(void);
 void LCD_BlinkOn(void);
 void LCD_BlinkOff(void);
@@ -107,6 +284,29 @@ void LCD_CursorOff(void);
 void LCD_ScrollLeft(void);
 void LCD_ScrollRight(void);
 
+/*
+	Marquee: text is written to DDRAM line once, then scrolled with display shift command (one command per step).
+	Text longer than DDRAM line (40 characters) is refilled in off-screen part of the line.
+	Display shift moves all rows: for 1 and 2 row displays (on 4 row displays row 0 continues in row 2).
+	Other prints are shifted too while marquee is running. Marquee writes to LCD directly, also with LCD_USE_FRAME_BUFFER.
+	
+	y: row 0 or 1
+	text: string, not copied (must stay valid). 0: removes text, row is cleared
+*/
+void LCD_Marquee(uint8_t y, const char* text);
+
+/* Scroll one character every step_ms */
+void LCD_MarqueeStart(uint16_t step_ms);
+
+/* Stop scrolling, text is shown from start */
+void LCD_MarqueeStop(void);
+
+/* Call from main loop: display shift and refill when step time elapsed (millis()) */
+void LCD_MarqueeTask(void);
+
+/* I2C backpack: backlight on (1) or off (0). GPIO: does nothing */
+void LCD_Backlight(uint8_t state);
+
 /**********************************************************/
 /*	CUSTOM CHARACTER FUNCTIONS */
 /**********************************************************/
@@ -124,6 +324,51 @@ void LCD_CreateChar(uint8_t location, uint8_t* data);
  */
 void LCD_PutCustom(uint8_t y, uint8_t x, uint8_t location);
 
+/**********************************************************/
+/*	GLYPH CACHE */
+/**********************************************************/
+/*
+	Glyphs are referenced by ID (0 - LCD_GLYPH_USER_MAX), driver maps them to 8 CGRAM slots (least recently used slot is replaced).
+	Bitmap is uploaded only if glyph is not in CGRAM or its bitmap changed (animated glyphs: same ID, new bitmap).
+	Slots written with LCD_CreateChar() are not used by cache until LCD_GlyphReset().
+	Note: replacing a slot changes all characters on screen that show it - up to 8 different glyphs can be visible at once.
+*/
+#define LCD_GLYPH_USER_MAX		0xEF		// IDs 0xF0 - 0xFE are used by bar graph and big digits
+#define LCD_GLYPH_NONE				0xFF
+
+/* Glyph IDs of driver helpers */
+#define LCD_GLYPH_BAR					0xF0		// 0xF1 - 0xF4: bar of 1 - 4 columns
+#define LCD_GLYPH_BIG_TOP			0xF8		// big digits: top, bottom, top and bottom bar
+#define LCD_GLYPH_BIG_BOTTOM	0xF9
+#define LCD_GLYPH_BIG_BOTH		0xFA
+
+#define LCD_CHAR_FULL_BLOCK		0xFF		// character ROM (A00, A02): all pixels on
+
+/*
+	Returns CGRAM slot (character code 0 - 7) of glyph, uploads bitmap if needed.
+	LCD_GLYPH_NONE: all slots are used by LCD_CreateChar(), glyph can't be shown.
+	bitmap: 8 bytes, 5 LSB of each byte is one pixel row.
+*/
+uint8_t LCD_GlyphSlot(uint8_t id, const uint8_t* bitmap);
+
+/* Puts glyph on LCD, uploads bitmap if needed. Nothing is drawn if there is no free slot */
+void LCD_PutGlyph(uint8_t y, uint8_t x, uint8_t id, const uint8_t* bitmap);
+
+/* Forget all CGRAM slots, including LCD_CreateChar() slots. Next use uploads bitmap again */
+void LCD_GlyphReset(void);
+
+/*
+	Horizontal bar graph: width characters, 5 pixel columns per character.
+	value: 0 - max. Uses up to 1 CGRAM slot (partial character), full characters are from character ROM.
+*/
+void LCD_BarGraph(uint8_t y, uint8_t x, uint8_t width, uint16_t value, uint16_t max);
+
+/*
+	Big digit (0 - 9): 3 columns, 2 rows (y and y + 1). Uses 3 CGRAM slots.
+	Other values clear digit area.
+*/
+void LCD_BigDigit(uint8_t y, uint8_t x, uint8_t digit);
+
 
 /**********************************************************/
 /*	PRIVATE FUNCTIONS */
@@ -132,8 +377,15 @@ void _lcd_init_pins(void);
 void _lcd_send_command(uint8_t cmd);
 void _lcd_send_command_4_bit(uint8_t cmd);
 void _lcd_send_data(uint8_t data);
+void _lcd_send_data_run(const uint8_t* data, uint8_t length);
 void _lcd_cursor_set(uint8_t row, uint8_t col);
+void _lcd_cursor_sync(void);
+void _lcd_put_char(char c);
+void _lcd_put_chars(const char* str, uint8_t length);
+void _lcd_put_nibble(uint8_t nibble, uint8_t rs);
+void _lcd_put_byte(uint8_t byte, uint8_t rs);
 void _lcd_enable_pulse(void);
+void _lcd_wait_busy(void);
 
 
 #endif /* __LCD_H */
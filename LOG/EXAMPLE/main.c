@@ -0,0 +1,67 @@
+/**
+  *	Deferred binary logging test (STM32F030)
+  *	LOG() records are sent over USART1 (PA9, PA10), decoded on PC:
+  *		stty -F /dev/ttyUSB0 19200 raw
+  *		./log_decode firmware.elf < /dev/ttyUSB0
+  *	Button (PA0) interrupt routine logs too.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds and buttons
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+#define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
+#define B1 GPIO_Pin_0	//GPIOA, PA0
+
+volatile uint32_t button_presses = 0;
+
+void GPIO_Setup( void )
+{
+	//STM32F030 discovery onboard leds and button
+	//LEDS
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	gpio_pinSetup(GPIOC, D2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		
+	//BUTTON 
+	gpio_pinSetup(GPIOA, B1, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_interrupt(GPIOA, B1, EXTI_Trigger_Rising, 1);
+}
+
+int main(void)
+{	
+	uint32_t blink_time = 0;
+	uint32_t blinks = 0;
+	float temperature = 21.5;
+	
+	GPIO_Setup();
+	systick_millis_init();
+	UART_Init();	// PA9, PA10: USART1 is used only for log records
+	
+	LOG("Boot, SystemCoreClock = %u Hz", SystemCoreClock);
+	
+	while(1){  
+		log_process();	// doesn't wait for UART
+		
+		if((millis() - blink_time) >= 500){
+			blink_time = millis();
+			gpio_toggleBit(GPIOC, D1);
+			blinks++;
+			temperature += 0.125;
+			LOG("Blink %u, temperature %.3f C, dropped %u", blinks, LOG_FLOAT(temperature), log_dropped());
+		}
+  }
+}
+
+// PA0 (button B1) interrupt handler
+void EXTI0_1_IRQHandler(void){
+	if(reg_extiPending(EXTI_Line0))  {
+		reg_extiClear(EXTI_Line0);
+		button_presses++;
+		gpio_toggleBit(GPIOC, D2);
+		LOG("Button pressed (%u), LED 0x%04x", button_presses, GPIOC->ODR & (D1 | D2));
+	}
+}
+  
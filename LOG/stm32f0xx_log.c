@@ -0,0 +1,88 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: deferred binary logging #####
+																			c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_log.h"
+
+static uint8_t log_buffer[LOG_BUFFER_SIZE];
+static atomic_ring_t log_ring = {0, 0, LOG_BUFFER_SIZE - 1};	// producers: LOG() (serialized), consumer: log_process()
+static volatile uint32_t log_drop_count = 0;
+
+/* Copy bytes to ring buffer from head + offset on, returns new offset */
+static uint16_t _log_put(uint16_t offset, const void* data, uint8_t length)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint16_t index = atomic_ringHead(&log_ring) + offset;
+
+	while(length--){
+		log_buffer[index & (LOG_BUFFER_SIZE - 1)] = *bytes++;
+		index++;
+		offset++;
+	}
+	return offset;
+}
+
+uint8_t log_write(uint16_t id, const uint32_t* args, uint8_t count)
+{
+	uint8_t header[4];
+	uint16_t length;
+	uint16_t offset;
+	#ifdef LOG_USE_TIMESTAMP
+		uint32_t timestamp = millis();
+	#endif
+
+	if(count > LOG_MAX_ARGS){
+		count = LOG_MAX_ARGS;
+	}
+	header[1] = id & 0xFF;
+	header[2] = id >> 8;
+	header[3] = count;
+	#ifdef LOG_USE_TIMESTAMP
+		header[0] = LOG_SYNC_TIMESTAMP;
+		length = 4 + 4 + 4 * count;
+	#else
+		header[0] = LOG_SYNC;
+		length = 4 + 4 * count;
+	#endif
+
+	atomic_enter();	// LOG() in interrupt routine can't interleave records
+	if(atomic_ringFree(&log_ring) < length){
+		log_drop_count++;
+		atomic_exit();
+		return 0;
+	}
+	offset = _log_put(0, header, 4);
+	#ifdef LOG_USE_TIMESTAMP
+		offset = _log_put(offset, &timestamp, 4);	// Cortex-M0: little endian
+	#endif
+	_log_put(offset, args, 4 * count);
+	atomic_ringPushN(&log_ring, length);
+	atomic_exit();
+	return 1;
+}
+
+void log_process(void)
+{
+	while(!atomic_ringEmpty(&log_ring) && reg_usartTxReady(LOG_USART)){
+		reg_usartSend(LOG_USART, log_buffer[atomic_ringTail(&log_ring)]);
+		atomic_ringPop(&log_ring);
+	}
+}
+
+void log_flush(void)
+{
+	while(!atomic_ringEmpty(&log_ring)){
+		log_process();
+	}
+}
+
+uint32_t log_dropped(void)
+{
+	return log_drop_count;
+}
@@ -0,0 +1,96 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: deferred binary logging #####
+																		header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Format strings are not formatted (and not even stored) on MCU: each LOG() format string is placed in
+ * .logfmt section, its address is the ID of the message. Only ID, optional millis() timestamp and
+ * 32 bit arguments are written to ring buffer, which is sent over UART from main loop (log_process()).
+ * Host tool (LOG/tools/log_decode.c) reads .logfmt from firmware ELF file and prints messages.
+ *
+ *	LOG("Stepper %d at position %d", axis, position);
+ *	LOG("Temperature: %.1f C", LOG_FLOAT(temperature));	// floats must be passed with LOG_FLOAT()
+ *	while(1){ log_process(); ... }
+ *
+ * Linker (GNU ld): .logfmt is not loaded into flash, addresses start at 0 - add to SECTIONS of linker script:
+ *	.logfmt 0 (INFO) : { KEEP(*(.logfmt)) }
+ * Other linkers: .logfmt can be placed in flash (strings use flash, IDs are still small), set LOG_FMT_BASE
+ * to its start address.
+ *
+ * Record: header (LOG_SYNC or LOG_SYNC_TIMESTAMP), ID (16 bit), number of arguments,
+ *	[timestamp (32 bit)], arguments (32 bit). Little endian.
+ * Supported conversions: %d %i %u %x %X %o %c %f %e %g (flags, width, precision), %%. No %s.
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_LOG_H
+#define __STM32F0XX_LOG_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "stm32f0xx_reg.h"
+#include "stm32f0xx_atomic.h"
+#include "systick_millis.h"
+
+//#define LOG_DISABLE					// LOG() is removed from code
+#define LOG_USE_TIMESTAMP				// millis() in each record
+
+#define LOG_USART				USART1	// initialized by user (UART_Init()), used only for log records
+#define LOG_BUFFER_SIZE	256			// must be power of 2
+#define LOG_MAX_ARGS		8
+#define LOG_FMT_BASE		0				// address of .logfmt section
+
+#define LOG_SYNC						0xA5	// record header
+#define LOG_SYNC_TIMESTAMP	0xA6	// record header: record with timestamp
+
+#ifdef LOG_DISABLE
+	#define LOG(fmt, ...)		do { } while (0)
+#else
+	/* Arguments are converted to uint32_t: integers up to 32 bits, floats with LOG_FLOAT() */
+	#define LOG(fmt, ...)	do { \
+			static const char _log_fmt[] __attribute__((section(".logfmt"), used)) = fmt; \
+			const uint32_t _log_args[] = {0, ##__VA_ARGS__}; \
+			log_write((uint16_t)((uint32_t)_log_fmt - LOG_FMT_BASE), &_log_args[1], (sizeof(_log_args) / sizeof(uint32_t)) - 1); \
+		} while (0)
+#endif
+
+/* float argument: bits are sent, host formats it */
+#define LOG_FLOAT(x)	log_float(x)
+
+static inline uint32_t log_float(float value) {
+	union {
+		float f;
+		uint32_t u;
+	} bits;
+
+	bits.f = value;
+	return bits.u;
+}
+
+/*
+	Write record to ring buffer (use LOG()). Can be called from interrupt routines.
+	Returns 0 if buffer is full - record is dropped and counted.
+*/
+uint8_t log_write(uint16_t id, const uint32_t* args, uint8_t count);
+
+/* Main loop: send buffered bytes while UART transmit register is empty. Doesn't wait. */
+void log_process(void);
+
+/* Send all buffered bytes (waits) */
+void log_flush(void);
+
+/* Dropped records (buffer full) */
+uint32_t log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_LOG_H */
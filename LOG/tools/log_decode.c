@@ -0,0 +1,286 @@
+ /*
+ ===============================================================================
+            ##### Host tool: decode binary log records (LOG()) #####
+																			c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Linux: reads format strings from .logfmt section of firmware ELF file, 
+ * decodes records from stdin (or file) and prints messages.
+ *
+ *	gcc -O2 -o log_decode log_decode.c
+ *	stty -F /dev/ttyUSB0 19200 raw
+ *	./log_decode firmware.elf < /dev/ttyUSB0
+ *	./log_decode firmware.elf capture.bin -b 0x08007000		(-b: LOG_FMT_BASE, if not 0)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <elf.h>
+
+#define LOG_SYNC						0xA5	// same as stm32f0xx_log.h
+#define LOG_SYNC_TIMESTAMP	0xA6
+#define LOG_MAX_ARGS				8
+
+static char* fmt_section;		// .logfmt content
+static uint32_t fmt_addr;		// .logfmt address
+static uint32_t fmt_size;
+static uint32_t fmt_base = 0;	// LOG_FMT_BASE
+
+static FILE* in;
+static uint8_t pushed[4];			// bytes given back after false sync
+static int pushed_count = 0;
+
+static int next_byte(void)
+{
+	if(pushed_count){
+		return pushed[--pushed_count];
+	}
+	return fgetc(in);
+}
+
+/* Read length bytes, 0 at end of input */
+static int read_bytes(uint8_t* data, int length)
+{
+	int c;
+
+	while(length--){
+		if((c = next_byte()) == EOF){
+			return 0;
+		}
+		*data++ = c;
+	}
+	return 1;
+}
+
+/* Read size bytes at offset, 0 if file is too short */
+static int read_at(FILE* f, uint32_t offset, void* data, uint32_t size)
+{
+	if(fseek(f, offset, SEEK_SET) != 0){
+		return 0;
+	}
+	return fread(data, 1, size, f) == size;
+}
+
+/* Load .logfmt section of 32 bit ELF file */
+static int load_formats(const char* path)
+{
+	FILE* f = fopen(path, "rb");
+	Elf32_Ehdr eh;
+	Elf32_Shdr* sh;
+	char* names;
+	uint32_t names_size;
+	int i;
+
+	if(f == 0){
+		perror(path);
+		return 0;
+	}
+	if((fread(&eh, sizeof(eh), 1, f) != 1) || (memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0) || (eh.e_ident[EI_CLASS] != ELFCLASS32)){
+		fprintf(stderr, "%s: not a 32 bit ELF file\n", path);
+		fclose(f);
+		return 0;
+	}
+	sh = calloc(eh.e_shnum, sizeof(Elf32_Shdr));
+	if((sh == 0) || (eh.e_shstrndx >= eh.e_shnum) || !read_at(f, eh.e_shoff, sh, eh.e_shnum * sizeof(Elf32_Shdr))){
+		fprintf(stderr, "%s: can't read section headers\n", path);
+		free(sh);
+		fclose(f);
+		return 0;
+	}
+	names_size = sh[eh.e_shstrndx].sh_size;
+	names = calloc(names_size + 1, 1);	// last name is terminated
+	if((names == 0) || !read_at(f, sh[eh.e_shstrndx].sh_offset, names, names_size)){
+		fprintf(stderr, "%s: can't read section names\n", path);
+		free(names);
+		free(sh);
+		fclose(f);
+		return 0;
+	}
+
+	for(i = 0; i < eh.e_shnum; i++){
+		if((sh[i].sh_name < names_size) && (strcmp(&names[sh[i].sh_name], ".logfmt") == 0)){
+			fmt_addr = sh[i].sh_addr;
+			fmt_size = sh[i].sh_size;
+			fmt_section = calloc(fmt_size + 1, 1);	// last string is terminated
+			if((fmt_section == 0) || !read_at(f, sh[i].sh_offset, fmt_section, fmt_size)){
+				fprintf(stderr, "%s: can't read .logfmt section\n", path);
+				free(fmt_section);
+				free(names);
+				free(sh);
+				fclose(f);
+				return 0;
+			}
+			break;
+		}
+	}
+	free(names);
+	free(sh);
+	fclose(f);
+	if(fmt_section == 0){
+		fprintf(stderr, "%s: no .logfmt section\n", path);
+		return 0;
+	}
+	return 1;
+}
+
+/* Format string of ID, 0 if ID is not start of a string */
+static const char* find_format(uint16_t id)
+{
+	uint32_t offset = id + fmt_base - fmt_addr;
+
+	if((id + fmt_base < fmt_addr) || (offset >= fmt_size)){
+		return 0;
+	}
+	if((offset > 0) && (fmt_section[offset - 1] != 0)){
+		return 0;
+	}
+	return &fmt_section[offset];
+}
+
+/* Number of arguments of format string, -1 if unsupported conversion */
+static int count_args(const char* fmt)
+{
+	int count = 0;
+
+	while(*fmt){
+		if(*fmt++ != '%'){
+			continue;
+		}
+		if(*fmt == '%'){
+			fmt++;
+			continue;
+		}
+		fmt += strspn(fmt, "-+ #0123456789.hlz");
+		if((*fmt == 0) || (strchr("diuxXocfeEgG", *fmt) == 0)){
+			return -1;
+		}
+		fmt++;
+		count++;
+	}
+	return count;
+}
+
+/* Print message: printf() with each 32 bit argument converted according to its conversion */
+static void print_message(const char* fmt, const uint32_t* args)
+{
+	char spec[32];
+	size_t length;
+	union {
+		uint32_t u;
+		float f;
+	} bits;
+
+	while(*fmt){
+		if(*fmt != '%'){
+			putchar(*fmt++);
+			continue;
+		}
+		if(fmt[1] == '%'){
+			putchar('%');
+			fmt += 2;
+			continue;
+		}
+		length = 1 + strspn(fmt + 1, "-+ #0123456789.");
+		if(length > sizeof(spec) - 2){
+			length = sizeof(spec) - 2;
+		}
+		memcpy(spec, fmt, length);
+		fmt += length;
+		fmt += strspn(fmt, "hlz");	// length modifiers: arguments are 32 bit
+		spec[length] = *fmt;
+		spec[length + 1] = 0;
+		switch(*fmt){
+			case 'd': case 'i':
+				printf(spec, (int32_t)*args);
+				break;
+			case 'c':
+				printf(spec, (int)(*args & 0xFF));
+				break;
+			case 'f': case 'e': case 'E': case 'g': case 'G':
+				bits.u = *args;
+				printf(spec, (double)bits.f);
+				break;
+			default:	// u x X o
+				printf(spec, *args);
+				break;
+		}
+		args++;
+		fmt++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t record[4 + 4 + 4 * LOG_MAX_ARGS];
+	uint32_t args[LOG_MAX_ARGS];
+	uint32_t timestamp;
+	const char* fmt;
+	int c, i, count, timestamped, length;
+	unsigned long decoded = 0, skipped = 0;
+
+	in = stdin;
+	if(argc < 2){
+		fprintf(stderr, "usage: %s firmware.elf [capture.bin] [-b LOG_FMT_BASE]\n", argv[0]);
+		return 1;
+	}
+	for(i = 2; i < argc; i++){
+		if((strcmp(argv[i], "-b") == 0) && (i + 1 < argc)){
+			fmt_base = strtoul(argv[++i], 0, 0);
+		}
+		else if((in = fopen(argv[i], "rb")) == 0){
+			perror(argv[i]);
+			return 1;
+		}
+	}
+	if(!load_formats(argv[1])){
+		return 1;
+	}
+
+	while((c = next_byte()) != EOF){
+		if((c != LOG_SYNC) && (c != LOG_SYNC_TIMESTAMP)){
+			skipped++;
+			continue;
+		}
+		// header: ID, number of arguments
+		record[0] = c;
+		if(!read_bytes(&record[1], 3)){
+			break;
+		}
+		fmt = find_format(record[1] | (record[2] << 8));
+		count = record[3];
+		if((fmt == 0) || (count > LOG_MAX_ARGS) || (count_args(fmt) != count)){
+			skipped++;	// not a record: resync from next byte on
+			for(i = 3; i > 0; i--){
+				pushed[pushed_count++] = record[i];
+			}
+			continue;
+		}
+		timestamped = (c == LOG_SYNC_TIMESTAMP);
+		length = (timestamped ? 4 : 0) + 4 * count;
+		if(!read_bytes(&record[4], length)){
+			break;
+		}
+		// little endian
+		timestamp = 0;
+		if(timestamped){
+			timestamp = record[4] | (record[5] << 8) | (record[6] << 16) | ((uint32_t)record[7] << 24);
+		}
+		for(i = 0; i < count; i++){
+			uint8_t* a = &record[4 + (timestamped ? 4 : 0) + 4 * i];
+			args[i] = a[0] | (a[1] << 8) | (a[2] << 16) | ((uint32_t)a[3] << 24);
+		}
+		if(timestamped){
+			printf("[%6lu.%03lu] ", (unsigned long)(timestamp / 1000), (unsigned long)(timestamp % 1000));
+		}
+		print_message(fmt, args);
+		putchar('\n');
+		fflush(stdout);
+		decoded++;
+	}
+	fprintf(stderr, "%lu records, %lu bytes skipped\n", decoded, skipped);
+	return 0;
+}
@@ -16,7 +16,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include <systick_millis.h>
 
-volatile uint32_t systick_millis = 0;
+volatile uint32_t systick_millis = 0;	// written only in SysTick_Handler (and restartMillis)
 
 /*
 	Timer 2 initialization.
@@ -35,6 +35,16 @@ void systick_millis_init()
 
 }	
 
+/*
+	System clock changed (clock_register() callback): new SysTick reload value.
+	Called with interrupts disabled, current millisecond is restarted.
+*/
+void systick_millis_clockUpdate(const RCC_ClocksTypeDef* clocks)
+{
+	SysTick->LOAD = INCREMENT_RESOLUTION * (clocks->SYSCLK_Frequency / 1000000) - 1;
+	SysTick->VAL = 0;
+}
+
 void SysTick_Handler(void)  
 {
   systick_millis++;
@@ -53,9 +63,8 @@ uint32_t millis()
 // param: unsigned long [milliseconds]
 void delay(uint32_t ms)
 {
-	uint32_t delay_millis = systick_millis;
-	delay_millis += ms;
-	while (systick_millis < delay_millis){
+	uint32_t start_millis = systick_millis;	// 32 bit read: atomic, no critical section needed
+	while ((systick_millis - start_millis) < ms){	// elapsed time: also correct when systick_millis overflows
 			__nop();
 		}
 }
@@ -30,6 +30,9 @@
 // "private" function. systick initialization.
 void systick_millis_init(void);
 
+// System clock changed: recalculate SysTick reload (register with clock_register())
+void systick_millis_clockUpdate(const RCC_ClocksTypeDef* clocks);
+
 // Return milliseconds from timer initialization or timer reset
 uint32_t millis(void);
 
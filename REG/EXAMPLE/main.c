@@ -0,0 +1,135 @@
+/**
+  *	Register access benchmark (STM32F030): SPL call vs inline register access
+  *	Core clock cycles per operation (SysTick), printed on USART1 (PA9, PA10):
+  *		GPIO_SetBits:          ...  reg_gpioSet:       ...
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds and buttons
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+#define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
+#define B1 GPIO_Pin_0	//GPIOA, PA0
+
+#define BENCH_LOOPS	100		// loops * cycles per loop < SysTick period (1 ms)
+
+volatile uint32_t bench_sink;	// results of reads are stored, so loops are not optimized away
+
+/*
+	Measure BENCH_LOOPS executions of op with interrupts disabled, result: cycles per loop * 100.
+	SysTick counts down from LOAD to 0 each millisecond.
+*/
+#define BENCH(op, result) { \
+		uint32_t i, start, end; \
+		__disable_irq(); \
+		start = SysTick->VAL; \
+		for(i = 0; i < BENCH_LOOPS; i++){ op; } \
+		end = SysTick->VAL; \
+		__enable_irq(); \
+		result = (end <= start) ? (start - end) : (start + SysTick->LOAD + 1 - end); \
+		result = result * 100 / BENCH_LOOPS; \
+	}
+
+static uint32_t empty_loop;	// loop overhead
+
+void GPIO_Setup( void )
+{
+	//STM32F030 discovery onboard leds and button
+	//LEDS
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	gpio_pinSetup(GPIOC, D2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+		
+	//BUTTON 
+	gpio_pinSetup(GPIOA, B1, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+}
+
+// TIM16 running (not started), no interrupt
+void TIM_Setup( void )
+{
+	TIM_TimeBaseInitTypeDef timer16;
+	
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM16, ENABLE);
+	TIM_TimeBaseStructInit(&timer16);
+	timer16.TIM_Prescaler = 47;
+	timer16.TIM_Period = 999;
+	TIM_TimeBaseInit(TIM16, &timer16);
+}
+
+// print result without loop overhead: cycles per operation, 2 decimals
+void print_result(char* name, uint32_t result)
+{
+	if(result < empty_loop){
+		result = empty_loop;
+	}
+	printString(name);
+	printFloat((float)(result - empty_loop) / 100);
+	printString("\t");
+}
+
+int main(void)
+{	
+	uint32_t spl, reg;
+	
+	GPIO_Setup();
+	TIM_Setup();
+	systick_millis_init();
+	UART_Init();	// PA9, PA10
+	
+	printLn();
+	printStringLn("Cycles per operation (SPL, inline register access)");
+	
+	BENCH(__NOP(), empty_loop);
+	
+	while(1){  
+		BENCH(GPIO_SetBits(GPIOC, D2), spl);
+		BENCH(reg_gpioSet(GPIOC, D2), reg);
+		print_result("GPIO_SetBits: ", spl);
+		print_result("reg_gpioSet: ", reg);
+		printLn();
+		
+		BENCH(GPIO_WriteBit(GPIOC, D2, Bit_RESET), spl);
+		BENCH(reg_gpioWrite(GPIOC, D2, 0), reg);
+		print_result("GPIO_WriteBit: ", spl);
+		print_result("reg_gpioWrite: ", reg);
+		printLn();
+		
+		BENCH(bench_sink = GPIO_ReadInputDataBit(GPIOA, B1), spl);
+		BENCH(bench_sink = reg_gpioRead(GPIOA, B1), reg);
+		print_result("GPIO_ReadInputDataBit: ", spl);
+		print_result("reg_gpioRead: ", reg);
+		printLn();
+		
+		BENCH(bench_sink = USART_GetFlagStatus(USART1, USART_FLAG_TXE), spl);
+		BENCH(bench_sink = reg_usartTxReady(USART1), reg);
+		print_result("USART_GetFlagStatus: ", spl);
+		print_result("reg_usartTxReady: ", reg);
+		printLn();
+		
+		// stepper delay: set period, reset counter, start timer
+		BENCH(TIM_SetAutoreload(TIM16, 999); TIM_SetCounter(TIM16, 0); TIM_Cmd(TIM16, ENABLE); TIM_Cmd(TIM16, DISABLE), spl);
+		BENCH(reg_timSetPeriod(TIM16, 999); reg_timSetCounter(TIM16, 0); reg_timStart(TIM16); reg_timStop(TIM16), reg);
+		print_result("TIM period/counter/start/stop: ", spl);
+		print_result("reg_tim...: ", reg);
+		printLn();
+		
+		// timer interrupt routine: check and clear update flag
+		BENCH(if(TIM_GetITStatus(TIM16, TIM_IT_Update) != RESET){ TIM_ClearITPendingBit(TIM16, TIM_IT_Update); }, spl);
+		BENCH(if(reg_timUpdatePending(TIM16)){ reg_timClearUpdate(TIM16); }, reg);
+		print_result("TIM_GetITStatus: ", spl);
+		print_result("reg_timUpdatePending: ", reg);
+		printLn();
+		
+		BENCH(if(EXTI_GetITStatus(EXTI_Line0) != RESET){ EXTI_ClearITPendingBit(EXTI_Line0); }, spl);
+		BENCH(if(reg_extiPending(EXTI_Line0)){ reg_extiClear(EXTI_Line0); }, reg);
+		print_result("EXTI_GetITStatus: ", spl);
+		print_result("reg_extiPending: ", reg);
+		printLn();
+		
+		printLn();
+		gpio_toggleBit(GPIOC, D1);
+		delay(2000);
+  }
+}
@@ -0,0 +1,143 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: direct register access (inline) #####
+																		header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Header only: hot path replacements for GPIO, USART, TIM, EXTI and DMA StdPeriph calls.
+ * SPL function = call + assert_param + read-modify-write, these are single load/store instructions
+ * after inlining. No parameter checks - use SPL for one time initialization.
+ *
+ *	reg_gpioSet(GPIOC, GPIO_Pin_9);						GPIO_SetBits()
+ *	reg_usartSend(USART1, 'x');								USART_SendData()
+ *	reg_timClearUpdate(TIM16);								TIM_ClearITPendingBit(TIM16, TIM_IT_Update)
+ *	if (reg_extiPending(EXTI_Line0))					EXTI_GetITStatus(EXTI_Line0) != RESET
+ *	if (reg_dmaPending(DMA1_IT_TC1))					DMA_GetITStatus(DMA1_IT_TC1) != RESET
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_REG_H
+#define __STM32F0XX_REG_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+
+/****************************************************************************************/
+/* GPIO */
+/****************************************************************************************/
+/* Set pins (GPIO_Pin_x mask): atomic, no read-modify-write */
+static inline void reg_gpioSet(GPIO_TypeDef* GPIOx, uint16_t pins) {
+	GPIOx->BSRR = pins;
+}
+
+/* Reset pins (GPIO_Pin_x mask) */
+static inline void reg_gpioReset(GPIO_TypeDef* GPIOx, uint16_t pins) {
+	GPIOx->BRR = pins;
+}
+
+/* Set (value != 0) or reset pins with single BSRR store */
+static inline void reg_gpioWrite(GPIO_TypeDef* GPIOx, uint16_t pins, uint8_t value) {
+	GPIOx->BSRR = value ? (uint32_t)pins : ((uint32_t)pins << 16);
+}
+
+/* Input state of pin: 0 or 1 (same as GPIO_ReadInputDataBit) */
+static inline uint8_t reg_gpioRead(GPIO_TypeDef* GPIOx, uint16_t pin) {
+	return (GPIOx->IDR & pin) ? 1 : 0;
+}
+
+/* Toggle pins: new state of all pins is written with single BSRR store */
+static inline void reg_gpioToggle(GPIO_TypeDef* GPIOx, uint16_t pins) {
+	uint32_t odr = GPIOx->ODR;
+	GPIOx->BSRR = ((odr & pins) << 16) | (~odr & pins);
+}
+
+/****************************************************************************************/
+/* USART */
+/****************************************************************************************/
+/* Transmit data register empty: next byte can be written */
+static inline uint8_t reg_usartTxReady(USART_TypeDef* USARTx) {
+	return (USARTx->ISR & USART_ISR_TXE) ? 1 : 0;
+}
+
+/* Write byte to transmit data register (check reg_usartTxReady() first) */
+static inline void reg_usartSend(USART_TypeDef* USARTx, uint8_t byte) {
+	USARTx->TDR = byte;
+}
+
+/* Receive data register not empty */
+static inline uint8_t reg_usartRxReady(USART_TypeDef* USARTx) {
+	return (USARTx->ISR & USART_ISR_RXNE) ? 1 : 0;
+}
+
+/* Read received byte, clears RXNE */
+static inline uint8_t reg_usartReceive(USART_TypeDef* USARTx) {
+	return (uint8_t)USARTx->RDR;
+}
+
+/****************************************************************************************/
+/* TIM */
+/****************************************************************************************/
+/* Auto reload value (period - 1) */
+static inline void reg_timSetPeriod(TIM_TypeDef* TIMx, uint32_t arr) {
+	TIMx->ARR = arr;
+}
+
+static inline void reg_timSetCounter(TIM_TypeDef* TIMx, uint32_t counter) {
+	TIMx->CNT = counter;
+}
+
+static inline void reg_timStart(TIM_TypeDef* TIMx) {
+	TIMx->CR1 |= TIM_CR1_CEN;
+}
+
+static inline void reg_timStop(TIM_TypeDef* TIMx) {
+	TIMx->CR1 &= (uint16_t)~TIM_CR1_CEN;
+}
+
+/* Update interrupt pending and enabled (same as TIM_GetITStatus(TIMx, TIM_IT_Update) != RESET) */
+static inline uint8_t reg_timUpdatePending(TIM_TypeDef* TIMx) {
+	return ((TIMx->SR & TIM_SR_UIF) && (TIMx->DIER & TIM_DIER_UIE)) ? 1 : 0;
+}
+
+/* Clear update flag: SR bits are cleared by writing 0, other flags are not affected */
+static inline void reg_timClearUpdate(TIM_TypeDef* TIMx) {
+	TIMx->SR = (uint16_t)~TIM_SR_UIF;
+}
+
+/****************************************************************************************/
+/* EXTI */
+/****************************************************************************************/
+/* Line (EXTI_Linex) pending */
+static inline uint8_t reg_extiPending(uint32_t line) {
+	return (EXTI->PR & line) ? 1 : 0;
+}
+
+/* Clear pending line: PR bits are cleared by writing 1 */
+static inline void reg_extiClear(uint32_t line) {
+	EXTI->PR = line;
+}
+
+/****************************************************************************************/
+/* DMA */
+/****************************************************************************************/
+/* Any of DMA1 interrupt flags (DMA1_IT_xxx mask) pending */
+static inline uint8_t reg_dmaPending(uint32_t flags) {
+	return (DMA1->ISR & flags) ? 1 : 0;
+}
+
+/* Clear DMA1 interrupt flags: IFCR bits are cleared by writing 1 */
+static inline void reg_dmaClear(uint32_t flags) {
+	DMA1->IFCR = flags;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_REG_H */
@@ -0,0 +1,106 @@
+/**
+  *	SPI master test (STM32F030)
+  *	SPI1: PA5 SCK, PA6 MISO, PA7 MOSI.
+  *	- SPI flash (W25Qxx, CS: PA4): JEDEC ID, then 256 byte read at 12 MHz (command and data transactions, 
+  *		chip select held in between). Result is sent over USART1 (PA9, PA10).
+  *	- 2 x 74HC595 (latch: PB1): 16 bit frame from callback chain, LED counter every 100 ms.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+//onboard leds
+#define D1 GPIO_Pin_9	//GPIOC, PC9 - GREEN
+
+#define FLASH_CS_Port		GPIOA
+#define FLASH_CS_Pin		GPIO_Pin_4
+#define SHIFT_LATCH_Port	GPIOB
+#define SHIFT_LATCH_Pin	GPIO_Pin_1
+
+uint8_t flash_command[4];
+uint8_t flash_id[4];
+uint8_t flash_data[256];
+uint16_t shift_value = 0;
+
+spi_transaction_t flash_cmd;
+spi_transaction_t flash_read;
+spi_transaction_t shift_write;
+
+// 74HC595 outputs are latched on chip select rising edge
+void shift_done(spi_transaction_t* transaction)
+{
+	reg_gpioSet(GPIOC, D1);
+}
+
+int main(void)
+{	
+	uint32_t shift_time = 0;
+	uint16_t i;
+	
+	gpio_pinSetup(GPIOC, D1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_10MHz);
+	systick_millis_init();
+	UART_Init();	// PA9, PA10
+	spi_init();
+	spi_csSetup(FLASH_CS_Port, FLASH_CS_Pin);
+	spi_csSetup(SHIFT_LATCH_Port, SHIFT_LATCH_Pin);
+	
+	// SPI flash: mode 0, 12 MHz (STM32F030 SPI master: max 18 MHz)
+	flash_cmd.cs_port = FLASH_CS_Port;
+	flash_cmd.cs_pin = FLASH_CS_Pin;
+	flash_cmd.tx = flash_command;
+	flash_cmd.length = 4;
+	flash_cmd.frame = SPI_FRAME_8BIT;
+	flash_cmd.mode = SPI_BaudRatePrescaler_4;
+	flash_read = flash_cmd;
+	flash_read.tx = 0;
+	flash_read.rx = flash_data;
+	flash_read.length = 256;
+	
+	// JEDEC ID: 0x9F, 3 bytes - single transaction, rx includes byte received during command
+	flash_command[0] = 0x9F;
+	flash_cmd.rx = flash_id;
+	flash_cmd.cs_hold = 0;
+	spi_transfer(&flash_cmd);
+	printString("JEDEC ID: ");
+	printNumber(flash_id[1], HEX);
+	printString(" ");
+	printNumber((flash_id[2] << 8) | flash_id[3], HEX);
+	printLn();
+	
+	// Read data: 0x03 + 24 bit address, then 256 bytes by DMA (SPI_DUMMY is sent)
+	flash_command[0] = 0x03;
+	flash_command[1] = 0x00;
+	flash_command[2] = 0x10;
+	flash_command[3] = 0x00;
+	flash_cmd.rx = 0;
+	flash_cmd.cs_hold = 1;
+	spi_submit(&flash_cmd);
+	spi_submit(&flash_read);	// both queued, CPU is free meanwhile
+	spi_wait(&flash_read);
+	for(i = 0; i < 16; i++){
+		printNumber(flash_data[i], HEX);
+		printString(" ");
+	}
+	printLn();
+	
+	// 74HC595: 16 bit frames, mode 0, 3 MHz
+	shift_write.cs_port = SHIFT_LATCH_Port;
+	shift_write.cs_pin = SHIFT_LATCH_Pin;
+	shift_write.tx = &shift_value;
+	shift_write.length = 1;
+	shift_write.frame = SPI_FRAME_16BIT;
+	shift_write.mode = SPI_BaudRatePrescaler_16;
+	shift_write.callback = shift_done;
+	
+	while(1){  
+		if(((millis() - shift_time) >= 100) && (shift_write.status == SPI_DONE)){
+			shift_time = millis();
+			shift_value++;
+			reg_gpioReset(GPIOC, D1);
+			spi_submit(&shift_write);
+		}
+  }
+}
+  
@@ -0,0 +1,190 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: SPI master with DMA and transaction queue #####
+																				c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx_spi_master.h"
+
+#define SPI_MODE_MASK		(SPI_CR1_BR | SPI_CR1_CPOL | SPI_CR1_CPHA)
+#define SPI_CONFIG_NONE	0xFFFF	// SPI not configured for any transaction yet
+
+static spi_transaction_t* spi_queue[SPI_QUEUE_SIZE];
+static atomic_ring_t spi_ring = {0, 0, SPI_QUEUE_SIZE - 1};	// tail: active transaction
+static spi_transaction_t* volatile spi_active = 0;
+static uint16_t spi_config = SPI_CONFIG_NONE;	// mode and frame of last transaction
+static GPIO_TypeDef* spi_cs_held_port = 0;		// chip select left active by cs_hold transaction
+static uint16_t spi_cs_held_pin;
+
+static const uint16_t spi_dummy_tx = SPI_DUMMY;
+static uint16_t spi_dummy_rx;
+
+/* Start transaction at queue tail. Interrupts disabled. */
+static void _spi_start_next(void) {
+	spi_transaction_t* transaction;
+	uint16_t config;
+	uint32_t size;
+
+	if (atomic_ringEmpty(&spi_ring)) {
+		spi_active = 0;
+		return;
+	}
+	transaction = spi_queue[atomic_ringTail(&spi_ring)];
+	spi_active = transaction;
+	transaction->status = SPI_ACTIVE;
+
+	// CR1 and frame size can be changed only when SPI is disabled (SPI is idle here)
+	config = (transaction->mode & SPI_MODE_MASK) | (transaction->frame << 15);
+	if (config != spi_config) {
+		SPI_Cmd(SPI_MASTER, DISABLE);
+		SPI_MASTER->CR1 = (SPI_MASTER->CR1 & ~SPI_MODE_MASK) | (transaction->mode & SPI_MODE_MASK);
+		if (transaction->frame == SPI_FRAME_16BIT) {
+			SPI_DataSizeConfig(SPI_MASTER, SPI_DataSize_16b);
+			SPI_RxFIFOThresholdConfig(SPI_MASTER, SPI_RxFIFOThreshold_HF);
+		}
+		else {
+			SPI_DataSizeConfig(SPI_MASTER, SPI_DataSize_8b);
+			SPI_RxFIFOThresholdConfig(SPI_MASTER, SPI_RxFIFOThreshold_QF);	// RXNE after each byte
+		}
+		SPI_Cmd(SPI_MASTER, ENABLE);
+		spi_config = config;
+	}
+
+	// chip select held by previous transaction: released if this transaction selects other device
+	if (spi_cs_held_port && ((spi_cs_held_port != transaction->cs_port) || (spi_cs_held_pin != transaction->cs_pin))) {
+		reg_gpioSet(spi_cs_held_port, spi_cs_held_pin);
+	}
+	spi_cs_held_port = 0;
+	if (transaction->cs_port) {
+		reg_gpioReset(transaction->cs_port, transaction->cs_pin);
+	}
+
+	// DMA channel registers: same bits as SPL DMA_InitTypeDef values
+	if (transaction->frame == SPI_FRAME_16BIT) {
+		size = DMA_PeripheralDataSize_HalfWord | DMA_MemoryDataSize_HalfWord;
+	}
+	else {
+		size = DMA_PeripheralDataSize_Byte | DMA_MemoryDataSize_Byte;
+	}
+	// RX first: must be ready before first frame is clocked out, higher priority (no overrun)
+	SPI_RX_DMA_Channel->CCR = size | DMA_DIR_PeripheralSRC | DMA_Priority_VeryHigh | DMA_IT_TC | DMA_IT_TE |
+		(transaction->rx ? DMA_MemoryInc_Enable : DMA_MemoryInc_Disable);
+	SPI_RX_DMA_Channel->CNDTR = transaction->length;
+	SPI_RX_DMA_Channel->CMAR = transaction->rx ? (uint32_t)transaction->rx : (uint32_t)&spi_dummy_rx;
+	SPI_TX_DMA_Channel->CCR = size | DMA_DIR_PeripheralDST | DMA_Priority_High |
+		(transaction->tx ? DMA_MemoryInc_Enable : DMA_MemoryInc_Disable);
+	SPI_TX_DMA_Channel->CNDTR = transaction->length;
+	SPI_TX_DMA_Channel->CMAR = transaction->tx ? (uint32_t)transaction->tx : (uint32_t)&spi_dummy_tx;
+	SPI_RX_DMA_Channel->CCR |= DMA_CCR_EN;
+	SPI_TX_DMA_Channel->CCR |= DMA_CCR_EN;	// TXE is set: transfer starts
+}
+
+void spi_init(void) {
+	SPI_InitTypeDef spi;
+	NVIC_InitTypeDef dma_int;
+
+	SPI_MASTER_RCC_CMD(SPI_MASTER_RCC, ENABLE);
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+	gpio_pinSetup_AF(SPI_SCK_Port, SPI_SCK_Pin, SPI_MASTER_AF, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_50MHz);
+	gpio_pinSetup_AF(SPI_MISO_Port, SPI_MISO_Pin, SPI_MASTER_AF, GPIO_OType_PP, GPIO_PuPd_UP, GPIO_Speed_50MHz);
+	gpio_pinSetup_AF(SPI_MOSI_Port, SPI_MOSI_Pin, SPI_MASTER_AF, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_50MHz);
+
+	SPI_StructInit(&spi);
+	spi.SPI_Direction = SPI_Direction_2Lines_FullDuplex;
+	spi.SPI_Mode = SPI_Mode_Master;
+	spi.SPI_DataSize = SPI_DataSize_8b;
+	spi.SPI_CPOL = SPI_CPOL_Low;
+	spi.SPI_CPHA = SPI_CPHA_1Edge;
+	spi.SPI_NSS = SPI_NSS_Soft;		// chip select: GPIO per transaction
+	spi.SPI_BaudRatePrescaler = SPI_BaudRatePrescaler_256;
+	spi.SPI_FirstBit = SPI_FirstBit_MSB;
+	SPI_Init(SPI_MASTER, &spi);
+	SPI_RxFIFOThresholdConfig(SPI_MASTER, SPI_RxFIFOThreshold_QF);
+	SPI_I2S_DMACmd(SPI_MASTER, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);	// DMA channels are enabled per transaction
+	spi_config = SPI_CONFIG_NONE;
+
+	SPI_RX_DMA_Channel->CPAR = (uint32_t)&SPI_MASTER->DR;
+	SPI_TX_DMA_Channel->CPAR = (uint32_t)&SPI_MASTER->DR;
+	reg_dmaClear(SPI_DMA_IT_ALL);
+
+	dma_int.NVIC_IRQChannel = SPI_DMA_IRQn;
+	dma_int.NVIC_IRQChannelPriority = 2;
+	dma_int.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&dma_int);
+}
+
+void spi_csSetup(GPIO_TypeDef* port, uint16_t pin) {
+	gpio_pinSetup(port, pin, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_NOPULL, GPIO_Speed_50MHz);
+	reg_gpioSet(port, pin);
+}
+
+uint8_t spi_submit(spi_transaction_t* transaction) {
+	atomic_enter();	// producers: main loop and interrupts
+	if (atomic_ringFull(&spi_ring)) {
+		atomic_exit();
+		return 0;
+	}
+	transaction->status = SPI_QUEUED;
+	spi_queue[atomic_ringHead(&spi_ring)] = transaction;
+	atomic_ringPush(&spi_ring);
+	if (spi_active == 0) {
+		_spi_start_next();
+	}
+	atomic_exit();
+	return 1;
+}
+
+void spi_wait(spi_transaction_t* transaction) {
+	while ((transaction->status == SPI_QUEUED) || (transaction->status == SPI_ACTIVE));
+}
+
+uint8_t spi_transfer(spi_transaction_t* transaction) {
+	while (spi_submit(transaction) == 0);
+	spi_wait(transaction);
+	return transaction->status;
+}
+
+uint8_t spi_busy(void) {
+	return (spi_active != 0);
+}
+
+/* RX transfer complete: all frames are clocked in, bus is idle */
+void SPI_DMA_IRQHandler(void) {
+	spi_transaction_t* transaction;
+	uint8_t status;
+
+	if (reg_dmaPending(SPI_DMA_IT_RX_TC | SPI_DMA_IT_RX_TE)) {
+		status = reg_dmaPending(SPI_DMA_IT_RX_TE) ? SPI_ERROR : SPI_DONE;
+		reg_dmaClear(SPI_DMA_IT_ALL);
+		SPI_RX_DMA_Channel->CCR &= ~DMA_CCR_EN;
+		SPI_TX_DMA_Channel->CCR &= ~DMA_CCR_EN;
+
+		transaction = spi_active;
+		if (transaction == 0) {
+			return;	// stale flag, no transaction in progress
+		}
+		if (transaction->cs_port) {
+			if (transaction->cs_hold) {
+				spi_cs_held_port = transaction->cs_port;
+				spi_cs_held_pin = transaction->cs_pin;
+			}
+			else {
+				reg_gpioSet(transaction->cs_port, transaction->cs_pin);
+			}
+		}
+		atomic_ringPop(&spi_ring);
+		transaction->status = status;
+		if (transaction->callback) {
+			transaction->callback(transaction);	// spi_active is set: submitted transactions are only queued
+		}
+
+		atomic_enter();	// higher priority interrupt may submit
+		_spi_start_next();
+		atomic_exit();
+	}
+}
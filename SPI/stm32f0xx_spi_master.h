@@ -0,0 +1,116 @@
+ /*
+ ===============================================================================
+            ##### STM32F0xx: SPI master with DMA and transaction queue #####
+																			header file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Transactions (user owned, must stay valid until done) are queued and transferred by DMA one after another:
+ * chip select, TX and RX buffers, 8 or 16 bit frames, baud rate and SPI mode per transaction.
+ * CPU is interrupted once per transaction (RX DMA transfer complete): chip select is released, callback
+ * is called and next transaction is started. STM32F030 datasheet: master SCK up to 18 MHz, with PCLK 48 MHz
+ * use SPI_BaudRatePrescaler_4 (12 MHz) or higher (prescaler 2 = 24 MHz is out of specification).
+ *
+ *	spi_init();
+ *	spi_csSetup(GPIOA, GPIO_Pin_4);
+ *	spi_transaction_t read = {GPIOA, GPIO_Pin_4, tx, rx, 16, SPI_FRAME_8BIT, SPI_BaudRatePrescaler_4, ...};
+ *	spi_submit(&read);		// returns immediately
+ *	spi_wait(&read);			// or callback, or poll read.status
+ *
+ * STM32F030 DMA: SPI1 RX/TX = DMA1 channel 2/3, LCD I2C mode also uses channel 2 - use SPI2 (channel 4/5).
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F0XX_SPI_MASTER_H
+#define __STM32F0XX_SPI_MASTER_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "stm32f0xx_spi.h"
+#include "stm32f0xx_dma.h"
+#include "stm32f0xx_rcc.h"
+#include "stm32f0xx_misc.h"
+#include "stm32f0xx_gpio_init.h"
+#include "stm32f0xx_reg.h"
+#include "stm32f0xx_atomic.h"
+
+/* SPI1: PA5 SCK, PA6 MISO, PA7 MOSI (SPI2: PB13, PB14, PB15, AF0) */
+#define SPI_MASTER						SPI1
+#define SPI_MASTER_RCC				RCC_APB2Periph_SPI1		// SPI2: RCC_APB1Periph_SPI2
+#define SPI_MASTER_RCC_CMD		RCC_APB2PeriphClockCmd	// SPI2: RCC_APB1PeriphClockCmd
+#define SPI_MASTER_AF					GPIO_AF_0
+#define SPI_SCK_Port					GPIOA
+#define SPI_SCK_Pin						GPIO_Pin_5
+#define SPI_MISO_Port					GPIOA
+#define SPI_MISO_Pin					GPIO_Pin_6
+#define SPI_MOSI_Port					GPIOA
+#define SPI_MOSI_Pin					GPIO_Pin_7
+#define SPI_RX_DMA_Channel		DMA1_Channel2					// SPI2: DMA1_Channel4
+#define SPI_TX_DMA_Channel		DMA1_Channel3					// SPI2: DMA1_Channel5
+#define SPI_DMA_IRQn					DMA1_Channel2_3_IRQn	// SPI2: DMA1_Channel4_5_IRQn
+#define SPI_DMA_IRQHandler		DMA1_Channel2_3_IRQHandler	// SPI2: DMA1_Channel4_5_IRQHandler
+#define SPI_DMA_IT_RX_TC			DMA1_IT_TC2						// SPI2: DMA1_IT_TC4
+#define SPI_DMA_IT_RX_TE			DMA1_IT_TE2						// SPI2: DMA1_IT_TE4
+#define SPI_DMA_IT_ALL				(DMA1_IT_GL2 | DMA1_IT_GL3)	// SPI2: (DMA1_IT_GL4 | DMA1_IT_GL5)
+
+#define SPI_QUEUE_SIZE		8				// must be power of 2, one slot is always free
+#define SPI_DUMMY					0xFFFF	// sent when transaction has no tx buffer
+
+/* frame size */
+#define SPI_FRAME_8BIT		0
+#define SPI_FRAME_16BIT		1
+
+/* transaction status */
+#define SPI_DONE					0				// zero initialized transaction is done
+#define SPI_QUEUED				1
+#define SPI_ACTIVE				2
+#define SPI_ERROR					3				// DMA error
+
+typedef struct spi_transaction spi_transaction_t;
+
+/* Called from DMA interrupt when transaction is done. May submit new transactions. */
+typedef void (*spi_callback_t)(spi_transaction_t* transaction);
+
+struct spi_transaction {
+	GPIO_TypeDef* cs_port;		// chip select (active low), 0: none
+	uint16_t cs_pin;
+	const void* tx;						// frames to send, 0: SPI_DUMMY is sent
+	void* rx;									// received frames, 0: discarded
+	uint16_t length;					// number of frames
+	uint8_t frame;						// SPI_FRAME_8BIT, SPI_FRAME_16BIT (tx, rx: uint16_t arrays)
+	uint16_t mode;						// SPI_BaudRatePrescaler_x | SPI_CPOL_x | SPI_CPHA_x
+	uint8_t cs_hold;					// 1: chip select stays active after transaction (command, then data),
+														// released when next transaction has other chip select
+	spi_callback_t callback;	// 0: none
+	void* context;						// user data for callback
+	volatile uint8_t status;	// SPI_DONE, SPI_QUEUED, SPI_ACTIVE, SPI_ERROR
+};
+
+/* Initialize SPI_MASTER pins, SPI (master, software chip select) and DMA channels */
+void spi_init(void);
+
+/* Chip select pin: output, inactive (high) */
+void spi_csSetup(GPIO_TypeDef* port, uint16_t pin);
+
+/* Queue transaction, start it if SPI is idle. Returns 0 if queue is full. Can be called from interrupts. */
+uint8_t spi_submit(spi_transaction_t* transaction);
+
+/* Wait until transaction is done (not from its own callback or higher priority interrupt) */
+void spi_wait(spi_transaction_t* transaction);
+
+/* Submit (wait for free slot) and wait. Returns transaction status: SPI_DONE or SPI_ERROR. */
+uint8_t spi_transfer(spi_transaction_t* transaction);
+
+/* Transaction in progress or queued */
+uint8_t spi_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0XX_SPI_MASTER_H */
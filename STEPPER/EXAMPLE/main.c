@@ -24,24 +24,38 @@ void GPIO_Setup( void )
 	gpio_pinSetup_interrupt(GPIOA, B1, EXTI_Trigger_Rising, 1);
 }
 
+// events from interrupt routines
+#define EVENT_BUTTON	0
+
+// button B1 pressed: called from main loop (event_dispatch())
+void button_handler(const event_t* event)
+{
+	gpio_toggleBit(GPIOC, D2);
+}
+
 int main(void)
 {	
 	uint8_t button_state = 0;
+	uint32_t blink_time = 0;
 	
 	GPIO_Setup();
 	systick_millis_init();
+	event_register(EVENT_BUTTON, button_handler);
 	
 	while(1){  
-		delay(200);
-		gpio_toggleBit(GPIOC, D1);
+		event_dispatch();
+		if((millis() - blink_time) >= 200){
+			blink_time = millis();
+			gpio_toggleBit(GPIOC, D1);
+		}
   }
 }
 
-// PA0 (button B1) interrupt handler
+// PA0 (button B1) interrupt handler: only posts event
 void EXTI0_1_IRQHandler(void){
-	if(EXTI_GetITStatus(EXTI_Line0) != RESET)  {	
-		EXTI_ClearFlag(EXTI_Line0);
-		gpio_toggleBit(GPIOC, D2);
+	if(reg_extiPending(EXTI_Line0))  {
+		reg_extiClear(EXTI_Line0);
+		event_post(EVENT_BUTTON, 0);
 	}
 }
 
@@ -29,8 +29,8 @@
 					steps_per_revolution = 4067;	
 						Note:  4076 is default for 28YBJ-48
 					
-					// if 4 pin motor is used, you can use half-stepping:
-					use_half_step = USE_HALF_STEP;
+					// if 4 pin motor is used, you can use half-stepping or wave drive (one coil at a time):
+					use_half_step = USE_HALF_STEP;	// USE_FULL_STEP, USE_HALF_STEP, USE_WAVE_STEP
 					
 					// define if last motor step state is preserved for one extra step delay time or reseted imediately. 
 					maintain_position = DONT_MAINTAIN_POS;	
@@ -39,6 +39,28 @@
 		(#) Init stepper: 
 			- stepperInit_2pin(stepper_struct* current_stepper);
 			- stepperInit_4pin(stepper_struct* current_stepper);
+			- stepperInit_microstep(stepper_struct* current_stepper);
+					Microstepping: H-bridge inputs (pin1 = A+, pin2 = B+, pin3 = A-, pin4 = B-) are driven with sine/cosine
+					PWM duty from channels 1-4 of TIM1 or TIM3. Set these structure variables before init: (example)
+						motor_pin_1 - 4: PA6, PA7, PB0, PB1 	(TIM3 CH1 - CH4)
+						pwm_timer = TIM3;
+						pwm_af = GPIO_AF_1;
+						microsteps = 16;	// 4, 8, 16 or 32
+					One step of move functions is one microstep, so steps_per_revolution must be multiplied by 
+					microsteps (full steps * microsteps).
+			- stepperInit_stepdir(stepper_struct* current_stepper);
+					External driver (A4988, DRV8825, TMC...) with STEP and DIR inputs. STEP pulses are generated by 
+					TIM15 or TIM17 PWM, in blocks of up to 256 pulses (repetition counter), so CPU is interrupted only
+					once per block. Set these structure variables before init: (example)
+						motor_pin_1 = STEP:	PA2 (TIM15 CH1, GPIO_AF_0) or PA7 (TIM17 CH1, GPIO_AF_5)
+						motor_pin_2 = DIR:	any GPIO pin
+						pwm_timer = TIM15;
+						pwm_af = GPIO_AF_0;
+					Set speed (up to tens of kHz) and acceleration ramp:
+						setSpeed(&stepper, 20000);
+						setAcceleration(&stepper, 50000);	// pulses/s^2, 0 = no ramp
+					Move with step(), moveToTargetPos() (blocking) or startMoveToTargetPos() and isMoving() (non-blocking).
+					Motion engine and moveToTargetPosOptimally() can't be used with STEP/DIR steppers.
 		
 		(#) Set stepper speed: [pulses per second] (up to 1000 for 28YBJ-48)
 			- setSpeed(&stepper, 500);	
@@ -73,9 +95,81 @@
 					and use 
 						moveToTargetPosOptimally();
 						
+			- Limit switch and homing (set after init()!):
+					limit_switch_bank = GPIOA;
+					limit_switch_pin = GPIO_Pin_5;
+					limit_switch_active = Bit_RESET;	// switch to GND, internal pull-up
+					home_direction = DIRECTION_CCW;
+				stepperLimitInit(&stepper);
+				and call limit switch callback from EXTI interrupt routine (see gpio_pinSetup_interrupt()):
+					void EXTI4_15_IRQHandler(void){
+						if(reg_extiPending(EXTI_Line5)){
+							reg_extiClear(EXTI_Line5);
+							stepperLimitCallback(EXTI_Line5);
+						}
+					}
+				Pressed switch stops move towards it within one step period (motion engine: all axes, one engine tick), 
+				moves towards pressed switch are not started. Moves away from switch (back off) are not stopped.
+				STEP/DIR: pulses of stopped block are counted from time since block start (systick_millis_init() 
+				must be called), without SysTick the whole block is added to lost_steps.
+				stepperHome(&stepper, 1000, 100, 50, 10000);
+					Seek switch with 1000 pps (max 10000 steps), back off 50 steps, approach again with 100 pps.
+					Switch position becomes home position. Call it again to check for lost steps: difference 
+					between expected and actual switch position is added to lost_steps.
+					Note: home before stepperEngineInit(), homing uses blocking move functions.
+				Driver stall output (TMC DIAG) can be used as limit switch - sensorless homing.
+				
+			- Coil power management (after init()):
+				stepperPowerInit(&stepper, 50, 30, 5000);
+					After each move coils stay at full current for 50 ms (settle), then holding current is reduced 
+					to 30 % and after 5 s of idle time coils are released. Move functions return immediately after 
+					last step (no extra maintain_position step delay). Timing and chopping are done in TIM14 
+					interrupt (STEPPER_POWER_TICK_FREQ), GPIO coils are chopped at STEPPER_POWER_TICK_FREQ/STEPPER_CHOP_STEPS, 
+					PWM (microstep) amplitude is scaled. STEP/DIR: use driver's own standstill current reduction.
+				
+			- Soft limits (set after init()!):
+					soft_limit_min = -100; soft_limit_max = 4000;
+				Moves are shortened to stay inside soft limits (not moveToTargetPosOptimally()).
+				
+			- User units: positions in degrees (default), millimeters, revolutions, ... as Q16.16 fixed point
+				stepperSetUnits(&stepper, 200*16, 8);		// 200 step motor, 1/16 microstep, 8 mm lead screw
+				stepperSetUnits(&stepper, 200*16, 1);		// revolutions
+				setSpeedUnits(&stepper, STEPPER_Q16(25));	// 25 mm/s
+				setAccelerationUnits(&stepper, STEPPER_Q16(100));	// 100 mm/s^2 (STEP/DIR)
+				moveToUnits(&stepper, STEPPER_Q16(12.5));	// move to 12.5 mm
+				moveByUnits(&stepper, STEPPER_Q16(0.1));	// +0.1 mm. Rounding error is not accumulated, 
+															// 10000 * 0.1 mm = exactly 1000 mm
+				getPositionUnits(&stepper);
+				unitsToSteps(), stepsToUnits()
+				Conversion factors are calculated once in stepperSetUnits(), conversions use one 32x32 bit 
+				multiplication and shift (Cortex-M0 has no hardware divider). Relative error < 2^-30.
+				
 			- int32_t angleToPulses(int32_t angle);
-				Convert angle to pulses - relative to stepper motor defines.
+				Convert angle to pulses - relative to stepper motor steps_per_revolution. Use unitsToSteps().
 				
+		(#) Motion engine: move up to STEPPER_MAX_AXES steppers at once (non-blocking)
+			- stepper_struct* axes[] = {&stepper_x, &stepper_y};
+				stepperEngineInit(axes, 2);
+					Note: init all steppers first. Blocking move functions can't be used after this call, TIM16 is
+					reconfigured as STEPPER_TICK_FREQ time base.
+			
+			- int32_t move[] = {400, -100};
+				stepperQueueMove(move, 800);
+				Queue relative move. 800 pulses per second is the speed of the axis with most steps, other axes are 
+				interpolated (Bresenham) so all axes start and finish together. Returns 0 if queue is full.
+				Speed is lowered if any axis would exceed its max_speed (0 = no limit).
+			
+			- stepperQueueTargetPos(800);
+				Queue move of all axes to their target_step_number.
+			
+			- stepperSetAcceleration(2000, 100);
+				Accelerate/decelerate with 2000 pulses/s^2. Consecutive queued moves are blended by look-ahead 
+				planner: motor doesn't stop between moves, junction speed is limited so that no axis changes 
+				its speed for more than 100 pulses per second (jerk) at once. Motor starts and stops with 
+				STEPPER_START_PPS. Queue moves ahead - a move can only be blended with moves queued before it starts.
+			
+			- stepperEngineBusy(); stepperEngineWait(); stepperEngineStop();
+			
 			Note: this driver uses TIM16 for delay generating
 			Note: this driver was tested with 28YBJ-48 small stepper motor:
 				http://arduino-info.wikispaces.com/SmallSteppers
@@ -85,8 +179,88 @@
 /* Includes ------------------------------------------------------------------*/
 #include <stm32f0xx_stepper.h>
 #include <stdlib.h>
+#include <math.h>
+
+atomic_flag_t TIM16_update_flag = 0;	// TIM16 update interrupt: step delay elapsed
+
+/* Motion engine "private variables" */
+static stepper_struct* engine_axes[STEPPER_MAX_AXES];
+static uint8_t engine_axis_count = 0;
+static volatile uint8_t engine_running = 0;		// TIM16 is running for motion engine
+#define TIMER16_DELAY		1	// TIM16 time base: timer16_init()
+#define TIMER16_ENGINE	2	// TIM16 time base: timer16_engine_init()
+static uint8_t timer16_mode = 0;					// 0: TIM16 not initialized
+static stepper_segment_t engine_queue[STEPPER_QUEUE_SIZE];
+static atomic_ring_t engine_ring = {0, 0, STEPPER_QUEUE_SIZE - 1};	// head: next free segment - main loop, tail: segment being executed - interrupt
+static int32_t engine_planned_position[STEPPER_MAX_AXES];	// axis positions at the end of the queue
+static uint32_t engine_acceleration = 0;	// [pulses/s^2], 0 = no ramps
+static uint32_t engine_jerk = STEPPER_DEFAULT_JERK;	// max instant speed change of any axis at junction [pps]
+static stepper_segment_t* volatile engine_segment = 0;	// segment being executed, 0 if none
+static volatile uint32_t engine_exit_rate = 0;	// rate at the end of executing/last executed segment [pps * 256]
+static int32_t engine_counter[STEPPER_MAX_AXES];	// Bresenham error counters
+static uint32_t engine_step_events_completed;
+static uint32_t engine_rate;	// current rate [pps * 256]
+static uint32_t engine_rate_accumulator = (STEPPER_TICK_FREQ << 8);
+static uint32_t engine_hold_countdown;
+static volatile uint8_t engine_abort = 0;	// limit switch: stop all axes on next engine tick
+
+static void _stepper_planner_recalculate(void);
+static uint32_t _stepper_rate_delta(void);
+static void _stepper_segment_profile(stepper_segment_t* segment, float entry_speed, float exit_speed, uint32_t* profile);
+static void _stepper_engine_tick(void);
+static void _stepper_single_step(stepper_struct* current_stepper, direction_t direction);
+static void _stepper_release(stepper_struct* current_stepper);
+static void _stepper_build_phase_table(stepper_struct* current_stepper);
+static void _stepper_pwm_timer_init(stepper_struct* current_stepper);
+static void _stepper_microstep(stepper_struct* current_stepper, uint8_t this_step);
+static uint16_t _stepdir_period(uint32_t pulsesPerSecond);
+static void _stepdir_build_ramp(stepper_struct* current_stepper);
+static void _stepdir_start(stepper_struct* current_stepper, int32_t steps_to_move);
+static uint16_t _stepdir_next_block(stepper_struct* current_stepper, uint16_t* period);
+static void _stepdir_preload_next(stepper_struct* current_stepper);
+static void _stepdir_update(stepper_struct* current_stepper);
+static void _stepdir_timestamp(uint32_t* ms, uint32_t* systick);
+static void _stepdir_abort(stepper_struct* current_stepper);
+static uint8_t _stepper_engine_towards_limit(stepper_struct* current_stepper);
+static void _stepper_limit_reset(stepper_struct* current_stepper);
+static uint8_t _stepper_limit_blocked(stepper_struct* current_stepper, int32_t steps_to_move);
+static int32_t _stepper_soft_limit(stepper_struct* current_stepper, int32_t position, int32_t steps_to_move);
+static void _stepper_unit_factor(uint64_t numerator, uint64_t denominator, uint32_t* factor, uint8_t* shift);
+static int32_t _stepper_unit_convert(int32_t value, uint32_t factor, uint8_t shift);
+static void _stepper_move_done(stepper_struct* current_stepper);
+static void _stepper_power_busy(stepper_struct* current_stepper);
+static void _stepper_power_idle(stepper_struct* current_stepper);
+static void _stepper_power_hold(stepper_struct* current_stepper);
+static void _stepper_power_timer_init(void);
+
+/* Power management "private variables": steppers handled in TIM14 interrupt */
+static stepper_struct* power_steppers[STEPPER_MAX_AXES + 1];
+static uint8_t power_chop_phase = 0;
+
+/* Limit switch "private variables" */
+static stepper_struct* limit_steppers[STEPPER_MAX_LIMIT_SWITCHES];
+
+/* STEP/DIR "private variables": steppers driven by TIM15/TIM17 update interrupt */
+static stepper_struct* stepdir_tim15_stepper = 0;
+static stepper_struct* stepdir_tim17_stepper = 0;
+
+/* STEP/DIR move phases */
+#define STEPDIR_ACCELERATE	0
+#define STEPDIR_CRUISE			1
+#define STEPDIR_DECELERATE	2
+#define STEPDIR_DONE				3
 
-uint8_t TIM16_update_flag = 0;
+/* Motor pin states for each step. bit0 = pin1, bit1 = pin2, bit2 = pin3, bit3 = pin4 */
+static const uint8_t phase_pattern_2pin[4] = {0x02, 0x03, 0x01, 0x00};	// 01, 11, 10, 00
+static const uint8_t phase_pattern_full[4] = {0x03, 0x06, 0x0C, 0x09};	// 1100, 0110, 0011, 1001
+static const uint8_t phase_pattern_half[8] = {0x01, 0x03, 0x02, 0x06, 0x04, 0x0C, 0x08, 0x09};	// 1000, 1100, 0100, 0110, 0010, 0011, 0001, 1001
+static const uint8_t phase_pattern_wave[4] = {0x01, 0x02, 0x04, 0x08};	// 1000, 0100, 0010, 0001
+
+/* Microstepping: quarter sine wave in 1/32 steps, amplitude = STEPPER_PWM_PERIOD */
+static const uint16_t microstep_sine[33] = {
+	0, 49, 98, 147, 195, 243, 290, 337, 383, 428, 471, 514, 556, 596, 634, 672, 
+	707, 741, 773, 803, 831, 858, 882, 904, 924, 942, 957, 970, 981, 989, 995, 999, 1000
+};
 
 void stepperInit_2pin(stepper_struct* current_stepper)
 {
@@ -94,10 +268,15 @@ void stepperInit_2pin(stepper_struct* current_stepper)
 	current_stepper->step_number = 0;							// which step the motor is on
   current_stepper->direction = DIRECTION_CW;		// motor direction
   current_stepper->use_half_step = 0; 					// 1 when the stepper motor is to be driven with half steps (only 4-wire)	
+	current_stepper->drive_mode = STEPPER_DRIVE_GPIO;		// coils switched with GPIO pins
 	setSpeed(current_stepper, DEFAULT_PPS);				// set default pulsesPerSecond
 	current_stepper->current_step_number = 0;			// set default current position to home position = 0;
 	current_stepper->target_step_number = 0;			// set default target position to be the same as home position = 0;
 	current_stepper->correction_pulses = 0;				// number of correction pulses - number of steps before output shaft actually moves
+	current_stepper->max_speed = 0;								// motion engine: no axis speed limit
+	current_stepper->power_managed = 0;						// coils released after move, see stepperPowerInit()
+	_stepper_limit_reset(current_stepper);				// no limit switch, no soft limits
+	stepperSetUnits(current_stepper, current_stepper->steps_per_revolution, 360);	// default user unit: degree
 	
 	// setup the pins on the microcontroller:
   gpio_pinSetup(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
@@ -109,6 +288,7 @@ void stepperInit_2pin(stepper_struct* current_stepper)
 	// pin_count is used by the stepMotor() method:
   current_stepper->pin_count = 2;
 	current_stepper->number_of_steps = 4;
+	_stepper_build_phase_table(current_stepper);
 	
 	timer16_init();
 }
@@ -118,10 +298,15 @@ void stepperInit_4pin(stepper_struct* current_stepper)
 	// set default values in current_stepper struct
 	current_stepper->step_number = 0;							// which step the motor is on
   current_stepper->direction = DIRECTION_CW;		// motor direction
+	current_stepper->drive_mode = STEPPER_DRIVE_GPIO;		// coils switched with GPIO pins
 	setSpeed(current_stepper, DEFAULT_PPS);				// set default pulsesPerSecond
 	current_stepper->current_step_number = 0;			// set default home position to current position = 0;
 	current_stepper->target_step_number = 0;			// set default target position to be the same as home position = 0;
 	current_stepper->correction_pulses = 0;				// number of correction pulses - number of steps before output shaft actually moves
+	current_stepper->max_speed = 0;								// motion engine: no axis speed limit
+	current_stepper->power_managed = 0;						// coils released after move, see stepperPowerInit()
+	_stepper_limit_reset(current_stepper);				// no limit switch, no soft limits
+	stepperSetUnits(current_stepper, current_stepper->steps_per_revolution, 360);	// default user unit: degree
 	
   // setup the pins on the microcontroller:
   gpio_pinSetup(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
@@ -143,9 +328,176 @@ void stepperInit_4pin(stepper_struct* current_stepper)
 	else{
 		current_stepper->number_of_steps = 4;
 	}
+	_stepper_build_phase_table(current_stepper);
+	timer16_init();
+}
+
+void stepperInit_microstep(stepper_struct* current_stepper)
+{
+	// set default values in current_stepper struct
+	current_stepper->step_number = 0;							// which step the motor is on
+  current_stepper->direction = DIRECTION_CW;		// motor direction
+	current_stepper->use_half_step = 0;
+	current_stepper->drive_mode = STEPPER_DRIVE_PWM;		// coils driven with PWM
+	setSpeed(current_stepper, DEFAULT_PPS);				// set default pulsesPerSecond
+	current_stepper->current_step_number = 0;			// set default home position to current position = 0;
+	current_stepper->target_step_number = 0;			// set default target position to be the same as home position = 0;
+	current_stepper->correction_pulses = 0;				// number of correction pulses - number of steps before output shaft actually moves
+	current_stepper->max_speed = 0;								// motion engine: no axis speed limit
+	current_stepper->power_managed = 0;						// coils released after move, see stepperPowerInit()
+	_stepper_limit_reset(current_stepper);				// no limit switch, no soft limits
+	stepperSetUnits(current_stepper, current_stepper->steps_per_revolution, 360);	// default user unit: degree
+	
+	// microsteps per full step: 4, 8, 16, 32. One electrical cycle = 4 full steps.
+	switch(current_stepper->microsteps)
+	{
+		case 4: current_stepper->microstep_shift = 3; break;
+		case 16: current_stepper->microstep_shift = 1; break;
+		case 32: current_stepper->microstep_shift = 0; break;
+		default: current_stepper->microsteps = 8; current_stepper->microstep_shift = 2; break;
+	}
+	current_stepper->microstep_scale = 256;	// full current
+	current_stepper->pin_count = 4;
+	current_stepper->number_of_steps = 4 * current_stepper->microsteps;
+	
+	// setup the pins on the microcontroller: timer channels 1 - 4
+	gpio_pinSetup_AF(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1, current_stepper->pwm_af, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_AF(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2, current_stepper->pwm_af, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_AF(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3, current_stepper->pwm_af, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup_AF(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4, current_stepper->pwm_af, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	_stepper_pwm_timer_init(current_stepper);	// all channels 0% duty
+	
 	timer16_init();
 }
 
+void stepperInit_stepdir(stepper_struct* current_stepper)
+{
+	TIM_TimeBaseInitTypeDef step_timer;
+	TIM_OCInitTypeDef step_channel;
+	NVIC_InitTypeDef step_timer_int;
+	RCC_ClocksTypeDef system_freq;
+	uint32_t timer_prescaler;
+	
+	// set default values in current_stepper struct
+	current_stepper->step_number = 0;							// which step the motor is on
+  current_stepper->direction = DIRECTION_CW;		// motor direction
+	current_stepper->use_half_step = 0;
+	current_stepper->drive_mode = STEPPER_DRIVE_STEPDIR;	// STEP pulses generated by pwm_timer
+	current_stepper->acceleration = 0;						// no acceleration ramp
+	current_stepper->stepdir_moving = 0;
+	setSpeed(current_stepper, DEFAULT_PPS);				// set default pulsesPerSecond
+	current_stepper->current_step_number = 0;			// set default home position to current position = 0;
+	current_stepper->target_step_number = 0;			// set default target position to be the same as home position = 0;
+	current_stepper->correction_pulses = 0;				// number of correction pulses - number of steps before output shaft actually moves
+	current_stepper->max_speed = 0;								// motion engine: no axis speed limit
+	current_stepper->power_managed = 0;						// coils released after move, see stepperPowerInit()
+	_stepper_limit_reset(current_stepper);				// no limit switch, no soft limits
+	stepperSetUnits(current_stepper, current_stepper->steps_per_revolution, 360);	// default user unit: degree
+	current_stepper->pin_count = 2;
+	current_stepper->number_of_steps = 4;
+	
+	// setup the pins on the microcontroller: STEP = timer channel 1, DIR = output
+	gpio_pinSetup_AF(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1, current_stepper->pwm_af, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	gpio_pinSetup(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2, GPIO_Mode_OUT, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+	GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
+	
+	RCC_GetClocksFreq(&system_freq);	//get system clocks
+	timer_prescaler = system_freq.PCLK_Frequency / STEPPER_STEPDIR_TIMER_FREQ;
+	if(timer_prescaler == 0){
+		timer_prescaler = 1;
+	}
+	
+	if(current_stepper->pwm_timer == TIM17){
+		RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM17, ENABLE);
+		stepdir_tim17_stepper = current_stepper;
+		step_timer_int.NVIC_IRQChannel = TIM17_IRQn;
+	}
+	else{
+		RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM15, ENABLE);
+		stepdir_tim15_stepper = current_stepper;
+		step_timer_int.NVIC_IRQChannel = TIM15_IRQn;
+	}
+	
+	step_timer.TIM_Prescaler = timer_prescaler - 1;
+	step_timer.TIM_CounterMode = TIM_CounterMode_Up;
+	step_timer.TIM_Period = current_stepper->cruise_period - 1;
+	step_timer.TIM_ClockDivision = TIM_CKD_DIV1;
+	step_timer.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(current_stepper->pwm_timer, &step_timer);
+	
+	// PWM1: STEP is high for STEPPER_STEPDIR_PULSE_WIDTH at the start of each period. Pulse = 0: no STEP pulses
+	TIM_OCStructInit(&step_channel);
+	step_channel.TIM_OCMode = TIM_OCMode_PWM1;
+	step_channel.TIM_OutputState = TIM_OutputState_Enable;
+	step_channel.TIM_OCPolarity = TIM_OCPolarity_High;
+	step_channel.TIM_Pulse = 0;
+	TIM_OC1Init(current_stepper->pwm_timer, &step_channel);
+	TIM_OC1PreloadConfig(current_stepper->pwm_timer, TIM_OCPreload_Enable);
+	TIM_ARRPreloadConfig(current_stepper->pwm_timer, ENABLE);
+	TIM_UpdateRequestConfig(current_stepper->pwm_timer, TIM_UpdateSource_Regular);	// software update doesn't generate interrupt
+	TIM_CtrlPWMOutputs(current_stepper->pwm_timer, ENABLE);
+	
+	step_timer_int.NVIC_IRQChannelPriority = 1;	// next block must be preloaded before current block ends
+	step_timer_int.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&step_timer_int);
+	
+	TIM_ClearITPendingBit(current_stepper->pwm_timer, TIM_IT_Update);
+	TIM_ITConfig(current_stepper->pwm_timer, TIM_IT_Update, ENABLE);
+	TIM_Cmd(current_stepper->pwm_timer, DISABLE);
+}
+
+/*
+	Set pwm_timer channels 1-4 to PWM mode, STEPPER_PWM_FREQ, duty 0.
+	Compare registers are preloaded, so new duty is applied at the start of next PWM period (no glitches).
+*/
+static void _stepper_pwm_timer_init(stepper_struct* current_stepper)
+{
+	TIM_TimeBaseInitTypeDef pwm_timer;
+	TIM_OCInitTypeDef pwm_channel;
+	RCC_ClocksTypeDef system_freq;
+	uint32_t timer_prescaler;
+	
+	RCC_GetClocksFreq(&system_freq);	//get system clocks
+	timer_prescaler = system_freq.PCLK_Frequency / (STEPPER_PWM_FREQ * STEPPER_PWM_PERIOD);
+	if(timer_prescaler == 0){
+		timer_prescaler = 1;
+	}
+	
+	if(current_stepper->pwm_timer == TIM1){
+		RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE);
+	}
+	else{
+		RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+	}
+	
+	pwm_timer.TIM_Prescaler = timer_prescaler - 1;
+	pwm_timer.TIM_CounterMode = TIM_CounterMode_Up;
+	pwm_timer.TIM_Period = STEPPER_PWM_PERIOD - 1;
+	pwm_timer.TIM_ClockDivision = TIM_CKD_DIV1;
+	pwm_timer.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(current_stepper->pwm_timer, &pwm_timer);
+	
+	TIM_OCStructInit(&pwm_channel);
+	pwm_channel.TIM_OCMode = TIM_OCMode_PWM1;
+	pwm_channel.TIM_OutputState = TIM_OutputState_Enable;
+	pwm_channel.TIM_OCPolarity = TIM_OCPolarity_High;
+	pwm_channel.TIM_Pulse = 0;
+	TIM_OC1Init(current_stepper->pwm_timer, &pwm_channel);
+	TIM_OC2Init(current_stepper->pwm_timer, &pwm_channel);
+	TIM_OC3Init(current_stepper->pwm_timer, &pwm_channel);
+	TIM_OC4Init(current_stepper->pwm_timer, &pwm_channel);
+	TIM_OC1PreloadConfig(current_stepper->pwm_timer, TIM_OCPreload_Enable);
+	TIM_OC2PreloadConfig(current_stepper->pwm_timer, TIM_OCPreload_Enable);
+	TIM_OC3PreloadConfig(current_stepper->pwm_timer, TIM_OCPreload_Enable);
+	TIM_OC4PreloadConfig(current_stepper->pwm_timer, TIM_OCPreload_Enable);
+	TIM_ARRPreloadConfig(current_stepper->pwm_timer, ENABLE);
+	
+	TIM_Cmd(current_stepper->pwm_timer, ENABLE);
+	if(current_stepper->pwm_timer == TIM1){
+		TIM_CtrlPWMOutputs(TIM1, ENABLE);	// advanced timer: main output enable
+	}
+}
+
 void timer16_init()
 {
 	TIM_TimeBaseInitTypeDef timer16;
@@ -176,16 +528,81 @@ void timer16_init()
 	TIM_ClearITPendingBit(TIM16, TIM_IT_Update);
 	TIM_ITConfig(TIM16, TIM_IT_Update, ENABLE);	//check smt32f0xx_tim.c
 	TIM_Cmd(TIM16, DISABLE);
-	TIM16_update_flag = 0;
+	atomic_flagClear(&TIM16_update_flag);
+	timer16_mode = TIMER16_DELAY;
 }	
 
 void TIM16_IRQHandler()
 {
-	if (TIM_GetITStatus(TIM16, TIM_IT_Update) != RESET)
+	if (reg_timUpdatePending(TIM16))
   {
-		TIM_ClearITPendingBit(TIM16, TIM_IT_Update);
-		TIM16_update_flag = 1;
-		
+		reg_timClearUpdate(TIM16);
+		atomic_flagSet(&TIM16_update_flag);
+		if(engine_running){
+			_stepper_engine_tick();
+		}
+	}
+}
+
+void timer16_engine_init()
+{
+	TIM_TimeBaseInitTypeDef timer16;
+	RCC_ClocksTypeDef system_freq;
+	NVIC_InitTypeDef timer16_int;
+	
+	RCC_GetClocksFreq(&system_freq);	//get system clocks
+	
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM16, ENABLE);
+	timer16.TIM_Prescaler = (system_freq.HCLK_Frequency / 1000000) - 1;	// 1us timer increment
+	timer16.TIM_CounterMode = TIM_CounterMode_Up;
+	timer16.TIM_Period = (1000000 / STEPPER_TICK_FREQ) - 1;						
+	timer16.TIM_ClockDivision = TIM_CKD_DIV1;
+	timer16.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(TIM16, &timer16);
+	
+	timer16_int.NVIC_IRQChannel = TIM16_IRQn;
+	timer16_int.NVIC_IRQChannelPriority = 1;	// step timing must not be delayed by other interrupts
+	timer16_int.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&timer16_int);
+
+	TIM_ClearITPendingBit(TIM16, TIM_IT_Update);
+	TIM_ITConfig(TIM16, TIM_IT_Update, ENABLE);
+	TIM_Cmd(TIM16, DISABLE);
+	timer16_mode = TIMER16_ENGINE;
+}
+
+/*
+	System clock changed (clock_register() callback): same prescaler calculation as in timer init functions.
+	New prescalers are loaded at next update event, so running periods are not cut.
+	Coil PWM timers (TIM1, TIM3) are not changed: PWM frequency scales with PCLK.
+*/
+void stepperClockUpdate(const RCC_ClocksTypeDef* clocks)
+{
+	uint32_t timer_prescaler;
+	
+	if(timer16_mode != 0){
+		if(timer16_mode == TIMER16_ENGINE){
+			timer_prescaler = (clocks->HCLK_Frequency / 1000000) - 1;	// 1us timer increment
+		}
+		else{
+			timer_prescaler = TIM16_INCREMENT_RESOLUTION * (clocks->HCLK_Frequency / 1000000);
+		}
+		TIM_PrescalerConfig(TIM16, timer_prescaler, TIM_PSCReloadMode_Update);
+	}
+	if(power_steppers[0] != 0){
+		TIM_PrescalerConfig(TIM14, (clocks->HCLK_Frequency / 1000000) - 1, TIM_PSCReloadMode_Update);
+	}
+	
+	// STEP/DIR: STEPPER_STEPDIR_TIMER_FREQ, periods are calculated from it
+	timer_prescaler = clocks->PCLK_Frequency / STEPPER_STEPDIR_TIMER_FREQ;
+	if(timer_prescaler == 0){
+		timer_prescaler = 1;
+	}
+	if(stepdir_tim15_stepper != 0){
+		TIM_PrescalerConfig(TIM15, timer_prescaler - 1, TIM_PSCReloadMode_Update);
+	}
+	if(stepdir_tim17_stepper != 0){
+		TIM_PrescalerConfig(TIM17, timer_prescaler - 1, TIM_PSCReloadMode_Update);
 	}
 }
 
@@ -194,25 +611,59 @@ Sets the speed in pulsesPerSecond: 1<1000
 */
 void setSpeed(stepper_struct* current_stepper, uint32_t pulsesPerSecond)
 {
-  uint32_t period = (1000000 / pulsesPerSecond) / TIM16_INCREMENT_RESOLUTION;
+  uint32_t period;
+	
+	if(pulsesPerSecond == 0){
+		pulsesPerSecond = 1;	// slowest speed, no division by 0
+	}
+	period = (1000000 / pulsesPerSecond) / TIM16_INCREMENT_RESOLUTION;
 	current_stepper->stepper_speed = period - 1;
+	current_stepper->speed_pps = pulsesPerSecond;
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		_stepdir_build_ramp(current_stepper);
+	}
 	//TIM_SetAutoreload(TIM3, period-1);
 }
 
+/*
+	STEP/DIR: set acceleration and deceleration in pulses/s^2. 0 = no ramp (start and stop with speed set with setSpeed()).
+	Motor starts and stops with STEPPER_START_PPS.
+*/
+void setAcceleration(stepper_struct* current_stepper, uint32_t pulsesPerSecond2)
+{
+	current_stepper->acceleration = pulsesPerSecond2;
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		_stepdir_build_ramp(current_stepper);
+	}
+}
+
 /*
   * Moves the motor steps_to_move steps.  If the number is negative, the motor moves in the reverse direction.
 	* blocking function - doesn't allow target change.
  */
 void step(stepper_struct* current_stepper, int steps_to_move)
 {  
-  int steps_left = abs(steps_to_move);  // how many steps to take
+  int steps_left;  // how many steps to take
+	
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		_stepdir_start(current_stepper, steps_to_move);
+		while(current_stepper->stepdir_moving);
+		return;
+	}
+	
+	steps_to_move = _stepper_soft_limit(current_stepper, current_stepper->current_step_number, steps_to_move);
+	if(_stepper_limit_blocked(current_stepper, steps_to_move)){
+		return;	// limit switch pressed
+	}
+	steps_left = abs(steps_to_move);
+	_stepper_power_busy(current_stepper);
 	 
   // determine direction based on whether steps_to_move is + or -:
   if (steps_to_move > 0) {current_stepper->direction = DIRECTION_CW;}
   if (steps_to_move < 0) {current_stepper->direction = DIRECTION_CCW;}
 
-  // decrement the number of steps, moving one step each time:
-  while(steps_left > 0) {			
+  // decrement the number of steps, moving one step each time (stop if limit switch is pressed):
+  while((steps_left > 0) && (current_stepper->limit_hit == 0)) {			
 
 		// increment or decrement the step number, depending on direction:
 		if( current_stepper->direction == DIRECTION_CW) {
@@ -232,37 +683,18 @@ void step(stepper_struct* current_stepper, int steps_to_move)
 		// decrement the steps left:
 		steps_left--;
 		
-		if (current_stepper->use_half_step)
-		{
-			// we have 8 steps, next step number will be 0, 1, 2, 3, 4, 5, 6 or 7:// JZ 20091104
-			stepMotor(current_stepper, current_stepper->step_number % 8);	// JZ 20091104
-		} else {
-			// step the motor to step number 0, 1, 2, or 3:
-			stepMotor(current_stepper, current_stepper->step_number % 4);
-		}
+		stepMotor(current_stepper, current_stepper->step_number);	// step the motor to step number 0 - (number_of_steps-1)
 		
 		// create step delay
-		TIM16_update_flag = 0;
-		TIM_SetAutoreload(TIM16, current_stepper->stepper_speed);	//set period
-		TIM_SetCounter(TIM16, 0);
-		TIM_Cmd(TIM16, ENABLE);
-		while(TIM16_update_flag != 1);
-		TIM_Cmd(TIM16, DISABLE);
+		atomic_flagClear(&TIM16_update_flag);
+		reg_timSetPeriod(TIM16, current_stepper->stepper_speed);	//set period
+		reg_timSetCounter(TIM16, 0);
+		reg_timStart(TIM16);
+		while(atomic_flagTake(&TIM16_update_flag) == 0);
+		reg_timStop(TIM16);
 	}	
-	if (current_stepper->maintain_position == MAINTAIN_POS){	//add aditional step delay, before pins are reseted
-		TIM16_update_flag = 0;
-		TIM_SetCounter(TIM16, 0);
-		TIM_Cmd(TIM16, ENABLE);
-		while(TIM16_update_flag != 1);
-		TIM_Cmd(TIM16, DISABLE);
-	}
-	//reset motor pins
-	GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-	GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-	if(current_stepper->pin_count == 4){
-		GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-		GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-	}
+	// hold (power manager) or reset motor pins
+	_stepper_move_done(current_stepper);
 	
 }
 
@@ -275,7 +707,22 @@ void moveToTargetPos(stepper_struct* current_stepper)
 {
 	int32_t steps_to_move = current_stepper->target_step_number - current_stepper->current_step_number;
 	
-	while (steps_to_move != 0){
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		do{	// target may change during move
+			startMoveToTargetPos(current_stepper);
+			while(current_stepper->stepdir_moving);
+		} while((current_stepper->target_step_number != current_stepper->current_step_number) && (current_stepper->limit_hit == 0) &&
+					(_stepper_soft_limit(current_stepper, current_stepper->current_step_number, current_stepper->target_step_number - current_stepper->current_step_number) != 0));
+		return;
+	}
+	
+	steps_to_move = _stepper_soft_limit(current_stepper, current_stepper->current_step_number, steps_to_move);
+	if(_stepper_limit_blocked(current_stepper, steps_to_move)){
+		return;	// limit switch pressed
+	}
+	_stepper_power_busy(current_stepper);
+	
+	while ((steps_to_move != 0) && (current_stepper->limit_hit == 0)){
 		if(steps_to_move >= 0){
 			steps_to_move += current_stepper->correction_pulses;
 		}
@@ -292,12 +739,7 @@ void moveToTargetPos(stepper_struct* current_stepper)
 			if( (current_stepper->step_number) == current_stepper->number_of_steps)	{
 				current_stepper->step_number = 0;
 			}
-			if (current_stepper->use_half_step){			
-				stepMotor(current_stepper, current_stepper->step_number % 8);	// step the motor to step number 0, 1, 2, 3, 4, 5, 6 or 7
-			} 
-			else{
-				stepMotor(current_stepper, current_stepper->step_number % 4); // step the motor to step number 0, 1, 2, or 3
-			}
+			stepMotor(current_stepper, current_stepper->step_number);	// step the motor to step number 0 - (number_of_steps-1)
 		}
 		else{	//direction = DIRECTION_CCW			
 			current_stepper->direction = DIRECTION_CCW;
@@ -310,40 +752,24 @@ void moveToTargetPos(stepper_struct* current_stepper)
 				current_stepper->step_number--;	// decrement motor current step number (1-number_of_steps)
 			}
 			
-			if (current_stepper->use_half_step){
-				stepMotor(current_stepper, current_stepper->step_number % 8);	// step the motor to step number 0, 1, 2, 3, 4, 5, 6 or 7
-			} 
-			else{
-				stepMotor(current_stepper, current_stepper->step_number % 4); // step the motor to step number 0, 1, 2, or 3
-			}
+			stepMotor(current_stepper, current_stepper->step_number);	// step the motor to step number 0 - (number_of_steps-1)
 		}
 	
 		// create step delay
-		TIM16_update_flag = 0;
-		TIM_SetAutoreload(TIM16, current_stepper->stepper_speed);	//set period
-		TIM_SetCounter(TIM16, 0);
-		TIM_Cmd(TIM16, ENABLE);
-		while(TIM16_update_flag != 1);
-		TIM_Cmd(TIM16, DISABLE);
+		atomic_flagClear(&TIM16_update_flag);
+		reg_timSetPeriod(TIM16, current_stepper->stepper_speed);	//set period
+		reg_timSetCounter(TIM16, 0);
+		reg_timStart(TIM16);
+		while(atomic_flagTake(&TIM16_update_flag) == 0);
+		reg_timStop(TIM16);
 		
 		// update steps to move(in the middle of this function some interrupt my change target position)
 		steps_to_move = current_stepper->target_step_number - current_stepper->current_step_number;
+		steps_to_move = _stepper_soft_limit(current_stepper, current_stepper->current_step_number, steps_to_move);
 	}	// end of while loop - step to target.
 	
-	if (current_stepper->maintain_position == MAINTAIN_POS){	//add aditional step delay, before pins are reseted
-		TIM16_update_flag = 0;
-		TIM_SetCounter(TIM16, 0);
-		TIM_Cmd(TIM16, ENABLE);
-		while(TIM16_update_flag != 1);
-		TIM_Cmd(TIM16, DISABLE);
-	}
-	//reset motor pins
-	GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-	GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-	if(current_stepper->pin_count == 4){
-		GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-		GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-	}
+	// hold (power manager) or reset motor pins
+	_stepper_move_done(current_stepper);
 }
 
 /* 
@@ -355,7 +781,9 @@ void moveToTargetPosOptimally(stepper_struct* current_stepper)
 	int32_t steps_to_move = 0;
 	int32_t abs_steps_to_move = 0;
 	
-	while (	current_stepper->target_step_number != current_stepper->current_step_number){
+	current_stepper->limit_hit = 0;
+	_stepper_power_busy(current_stepper);
+	while (	(current_stepper->target_step_number != current_stepper->current_step_number) && (current_stepper->limit_hit == 0)){
 		
 		steps_to_move = current_stepper->target_step_number - current_stepper->current_step_number;
 		abs_steps_to_move = abs(steps_to_move);
@@ -377,12 +805,7 @@ void moveToTargetPosOptimally(stepper_struct* current_stepper)
 				current_stepper->step_number = 0;
 			}
 
-			if (current_stepper->use_half_step){
-				stepMotor(current_stepper, current_stepper->step_number % 8);	// step the motor to step number 0, 1, 2, 3, 4, 5, 6 or 7
-			} 
-			else{
-				stepMotor(current_stepper, current_stepper->step_number % 4); // step the motor to step number 0, 1, 2, or 3
-			}
+			stepMotor(current_stepper, current_stepper->step_number);	// step the motor to step number 0 - (number_of_steps-1)
 		}
 		else{	//direction = DIRECTION_CCW
 			current_stepper->direction = DIRECTION_CCW;
@@ -395,21 +818,16 @@ void moveToTargetPosOptimally(stepper_struct* current_stepper)
 				current_stepper->step_number--;	// increment motor current step number (1-number_of_steps)
 			}
 			
-			if (current_stepper->use_half_step){
-				stepMotor(current_stepper, current_stepper->step_number % 8);	// step the motor to step number 0, 1, 2, 3, 4, 5, 6 or 7
-			} 
-			else{
-				stepMotor(current_stepper, current_stepper->step_number % 4); // step the motor to step number 0, 1, 2, or 3
-			}
+			stepMotor(current_stepper, current_stepper->step_number);	// step the motor to step number 0 - (number_of_steps-1)
 		}
 	
 		// create step delay
-		TIM16_update_flag = 0;
-		TIM_SetAutoreload(TIM16, current_stepper->stepper_speed);	//set period
-		TIM_SetCounter(TIM16, 0);
-		TIM_Cmd(TIM16, ENABLE);
-		while(TIM16_update_flag != 1);
-		TIM_Cmd(TIM16, DISABLE);
+		atomic_flagClear(&TIM16_update_flag);
+		reg_timSetPeriod(TIM16, current_stepper->stepper_speed);	//set period
+		reg_timSetCounter(TIM16, 0);
+		reg_timStart(TIM16);
+		while(atomic_flagTake(&TIM16_update_flag) == 0);
+		reg_timStop(TIM16);
 		
 		if (current_stepper->current_step_number > (current_stepper->steps_per_revolution/2)){
 			current_stepper->current_step_number = -((current_stepper->steps_per_revolution/2)-1);
@@ -420,37 +838,270 @@ void moveToTargetPosOptimally(stepper_struct* current_stepper)
 		
 	}	// end of while loop - step to target.
 	
-	if (current_stepper->maintain_position == MAINTAIN_POS){	//add aditional step delay, before pins are reseted
-		TIM16_update_flag = 0;
-		TIM_SetCounter(TIM16, 0);
-		TIM_Cmd(TIM16, ENABLE);
-		while(TIM16_update_flag != 1);
-		TIM_Cmd(TIM16, DISABLE);
-	}
-	//reset motor pins
-	GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-	GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-	if(current_stepper->pin_count == 4){
-		GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-		GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-	}
+	// hold (power manager) or reset motor pins
+	_stepper_move_done(current_stepper);
+}
+
+// STEP/DIR: start move to target_step_number and return immediately
+void startMoveToTargetPos(stepper_struct* current_stepper)
+{
+	_stepdir_start(current_stepper, current_stepper->target_step_number - current_stepper->current_step_number);
+}
+
+// STEP/DIR: returns 1 while motor is moving
+uint8_t isMoving(stepper_struct* current_stepper)
+{
+	return current_stepper->stepdir_moving;
 }
 
 // set home position
 void setHomePos(stepper_struct* current_stepper)
 {
 	current_stepper->current_step_number = 0;
+	current_stepper->unit_position = 0;
+	current_stepper->unit_position_steps = 0;
+}
+
+/*
+	Coil power management: after move coils stay at full current for settle_ms, then current is reduced to
+	hold_current (0-100 %) and after idle_timeout_ms (0 = never) coils are released. Handled in TIM14 interrupt, 
+	move functions don't wait. Not for STEP/DIR (external driver).
+*/
+void stepperPowerInit(stepper_struct* current_stepper, uint16_t settle_ms, uint8_t hold_current, uint32_t idle_timeout_ms)
+{
+	uint8_t i;
+	
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		return;
+	}
+	if(hold_current > 100){
+		hold_current = 100;
+	}
+	// ms to ticks and percent to chop/amplitude, calculated once
+	current_stepper->hold_settle_ticks = settle_ms * (STEPPER_POWER_TICK_FREQ / 1000);
+	current_stepper->hold_timeout_ticks = idle_timeout_ms * (STEPPER_POWER_TICK_FREQ / 1000);
+	current_stepper->hold_chop = (hold_current * STEPPER_CHOP_STEPS + 50) / 100;
+	current_stepper->hold_scale = (hold_current * 256 + 50) / 100;
+	current_stepper->power_state = STEPPER_POWER_OFF;
+	
+	if(power_steppers[0] == 0){
+		_stepper_power_timer_init();
+	}
+	for(i = 0; i < (STEPPER_MAX_AXES + 1); i++){
+		if((power_steppers[i] == 0) || (power_steppers[i] == current_stepper)){
+			power_steppers[i] = current_stepper;
+			current_stepper->power_managed = 1;
+			break;
+		}
+	}
 }
 
 // move to home position
 void moveToHomePos(stepper_struct* current_stepper)
 {
-	if (current_stepper->current_step_number > 0){
-		step(current_stepper, - current_stepper->current_step_number);
+	step(current_stepper, -current_stepper->current_step_number);
+}
+
+/*
+	Limit switch: configure limit_switch_bank/limit_switch_pin as input with EXTI interrupt on switch press.
+	Internal pull-up (limit_switch_active = Bit_RESET) or pull-down (Bit_SET) is used.
+	Call stepperLimitCallback() from EXTIx_IRQHandler of this pin.
+*/
+void stepperLimitInit(stepper_struct* current_stepper)
+{
+	uint8_t i;
+	
+	if(current_stepper->limit_switch_active == Bit_RESET){
+		gpio_pinSetup(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_UP, GPIO_Speed_50MHz);
+		gpio_pinSetup_interrupt(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin, EXTI_Trigger_Falling, 0);
 	}
 	else{
-		step(current_stepper, current_stepper->current_step_number);
+		gpio_pinSetup(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin, GPIO_Mode_IN, GPIO_OType_PP, GPIO_PuPd_DOWN, GPIO_Speed_50MHz);
+		gpio_pinSetup_interrupt(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin, EXTI_Trigger_Rising, 0);
+	}
+	
+	for(i = 0; i < STEPPER_MAX_LIMIT_SWITCHES; i++){
+		if((limit_steppers[i] == 0) || (limit_steppers[i] == current_stepper)){
+			limit_steppers[i] = current_stepper;
+			break;
+		}
+	}
+}
+
+/*
+	Limit switch interrupt: call from EXTIx_IRQHandler. 
+	EXTI_Line: EXTI_Line0 - EXTI_Line15 (same as GPIO_Pin_x of limit switch)
+	Stops moves towards the switch (home_direction): blocking moves after current step, STEP/DIR pulses 
+	immediately and motion engine on next tick. Moves away from the switch continue.
+*/
+void stepperLimitCallback(uint32_t EXTI_Line)
+{
+	stepper_struct* current_stepper;
+	uint8_t i, axis;
+	uint8_t engine_axis;
+	
+	for(i = 0; i < STEPPER_MAX_LIMIT_SWITCHES; i++){
+		current_stepper = limit_steppers[i];
+		if((current_stepper == 0) || (current_stepper->limit_switch_pin != EXTI_Line)){
+			continue;
+		}
+		if(reg_gpioRead(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin) != current_stepper->limit_switch_active){
+			continue;	// other port on the same EXTI line or switch bounce
+		}
+		
+		engine_axis = 0;
+		for(axis = 0; axis < engine_axis_count; axis++){
+			if(engine_axes[axis] == current_stepper){
+				engine_axis = 1;
+			}
+		}
+		if(engine_axis && engine_running){
+			if(_stepper_engine_towards_limit(current_stepper)){
+				current_stepper->limit_hit = 1;
+				engine_abort = 1;
+			}
+			continue;
+		}
+		
+		if(current_stepper->direction != current_stepper->home_direction){
+			continue;	// moving away from switch (back off)
+		}
+		current_stepper->limit_hit = 1;
+		if((current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR) && current_stepper->stepdir_moving){
+			_stepdir_abort(current_stepper);
+		}
+	}
+}
+
+/*
+	Automatic homing with limit switch (stepperLimitInit()). Blocking.
+		1. move towards switch (home_direction) with seek_speed, max max_travel steps
+		2. back off backoff_steps
+		3. approach again with locate_speed, max 2*backoff_steps
+	Switch position becomes home position (0). If the motor was already homed, difference between expected 
+	(home) and actual switch position is added to lost_steps.
+	Returns 1 on success, 0 if switch was not found.
+*/
+uint8_t stepperHome(stepper_struct* current_stepper, uint32_t seek_speed, uint32_t locate_speed, uint32_t backoff_steps, uint32_t max_travel)
+{
+	uint32_t speed = current_stepper->speed_pps;
+	int32_t soft_limit_min = current_stepper->soft_limit_min;
+	int32_t soft_limit_max = current_stepper->soft_limit_max;
+	int32_t towards_switch = 1;
+	uint8_t found = 0;
+	
+	if(current_stepper->home_direction == DIRECTION_CCW){
+		towards_switch = -1;
+	}
+	current_stepper->soft_limit_min = 0;	// soft limits disabled while homing
+	current_stepper->soft_limit_max = 0;
+	
+	// switch already pressed: move away first
+	if(reg_gpioRead(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin) == current_stepper->limit_switch_active){
+		setSpeed(current_stepper, locate_speed);
+		step(current_stepper, -towards_switch * (int32_t)backoff_steps);
+	}
+	
+	// seek
+	setSpeed(current_stepper, seek_speed);
+	step(current_stepper, towards_switch * (int32_t)max_travel);
+	if(current_stepper->limit_hit){
+		// back off and locate slowly
+		step(current_stepper, -towards_switch * (int32_t)backoff_steps);
+		setSpeed(current_stepper, locate_speed);
+		step(current_stepper, towards_switch * 2 * (int32_t)backoff_steps);
+		if(current_stepper->limit_hit){
+			found = 1;
+			if(current_stepper->homed){
+				current_stepper->lost_steps += abs(current_stepper->current_step_number);
+			}
+			current_stepper->current_step_number = 0;
+			current_stepper->target_step_number = 0;
+			current_stepper->homed = 1;
+		}
+	}
+	
+	current_stepper->soft_limit_min = soft_limit_min;
+	current_stepper->soft_limit_max = soft_limit_max;
+	setSpeed(current_stepper, speed);
+	return found;
+}
+
+// no limit switch, no soft limits
+static void _stepper_limit_reset(stepper_struct* current_stepper)
+{
+	current_stepper->limit_switch_bank = 0;
+	current_stepper->soft_limit_min = 0;
+	current_stepper->soft_limit_max = 0;
+	current_stepper->lost_steps = 0;
+	current_stepper->limit_hit = 0;
+	current_stepper->homed = 0;
+}
+
+/*
+	Returns 1 if limit switch is pressed and move is towards it: limit_hit is set, as if the switch was hit 
+	during the move (stepperHome(): back off shorter than switch hysteresis). Otherwise clears limit_hit of previous move.
+*/
+static uint8_t _stepper_limit_blocked(stepper_struct* current_stepper, int32_t steps_to_move)
+{
+	current_stepper->limit_hit = 0;
+	if((current_stepper->limit_switch_bank == 0) || (steps_to_move == 0)){
+		return 0;
+	}
+	if(reg_gpioRead(current_stepper->limit_switch_bank, current_stepper->limit_switch_pin) != current_stepper->limit_switch_active){
+		return 0;
+	}
+	if(((current_stepper->home_direction == DIRECTION_CW) && (steps_to_move > 0)) ||
+		((current_stepper->home_direction == DIRECTION_CCW) && (steps_to_move < 0))){
+		current_stepper->limit_hit = 1;
+		return 1;
+	}
+	return 0;
+}
+
+// motion engine: returns 1 if executing (or next) segment moves this axis towards its limit switch
+static uint8_t _stepper_engine_towards_limit(stepper_struct* current_stepper)
+{
+	stepper_segment_t* segment = engine_segment;
+	uint8_t axis;
+	
+	if(segment == 0){
+		if(atomic_ringEmpty(&engine_ring)){
+			return 0;
+		}
+		segment = &engine_queue[atomic_ringTail(&engine_ring)];
+	}
+	for(axis = 0; axis < engine_axis_count; axis++){
+		if((engine_axes[axis] != current_stepper) || (segment->steps[axis] == 0)){
+			continue;
+		}
+		if(segment->direction_bits & (1 << axis)){
+			return (current_stepper->home_direction == DIRECTION_CW);
+		}
+		return (current_stepper->home_direction == DIRECTION_CCW);
+	}
+	return 0;
+}
+
+// returns steps_to_move from position, shortened to stay within soft limits
+static int32_t _stepper_soft_limit(stepper_struct* current_stepper, int32_t position, int32_t steps_to_move)
+{
+	if(current_stepper->soft_limit_min >= current_stepper->soft_limit_max){
+		return steps_to_move;	// soft limits disabled
 	}
+	if((steps_to_move > 0) && (position + steps_to_move > current_stepper->soft_limit_max)){
+		steps_to_move = current_stepper->soft_limit_max - position;
+		if(steps_to_move < 0){
+			steps_to_move = 0;
+		}
+	}
+	if((steps_to_move < 0) && (position + steps_to_move < current_stepper->soft_limit_min)){
+		steps_to_move = current_stepper->soft_limit_min - position;
+		if(steps_to_move > 0){
+			steps_to_move = 0;
+		}
+	}
+	return steps_to_move;
 }
 
 /* convert angle to pulses - relative to stepper motor defines
@@ -459,115 +1110,1210 @@ void moveToHomePos(stepper_struct* current_stepper)
 */ 
 int32_t angleToPulses(stepper_struct* current_stepper, int32_t angle)
 {
-	int32_t angle_per_pulse = 360*10000 / current_stepper->steps_per_revolution;	//single pulse is  __ degrees
-	int32_t pulses = angle*10000 / angle_per_pulse;		// */ 10000 - to avoid calculating with floats 
-	return pulses;
+	int64_t pulses = (int64_t)angle * current_stepper->steps_per_revolution;	// exact, no overflow
+	
+	if(pulses >= 0){
+		return (pulses + 180) / 360;
+	}
+	return (pulses - 180) / 360;
 }
 
 /*
- * Moves the motor forward or backwards.
- */
-void stepMotor(stepper_struct* current_stepper, int this_step)
+	User units: "steps" steps are "units" user units, for example:
+		degrees:					stepperSetUnits(&stepper, steps_per_revolution, 360);
+		revolutions:			stepperSetUnits(&stepper, steps_per_revolution, 1);
+		mm, lead screw:		stepperSetUnits(&stepper, steps_per_revolution, lead_mm);
+		mm, 1.25 mm lead:	stepperSetUnits(&stepper, steps_per_revolution * 4, 5);
+	Ratio is converted to 32 bit factor and shift, so later conversions don't need divisions.
+*/
+void stepperSetUnits(stepper_struct* current_stepper, uint32_t steps, uint32_t units)
 {
-	if (current_stepper->pin_count == 2) {
-    switch (this_step) {
-      case 0: /* 01 */
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				break;
-      case 1: /* 11 */
-				GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				break;
-      case 2: /* 10 */
-				GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				break;
-      case 3: /* 00 */
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				break;
-    } 
-  }
-  if ((current_stepper->pin_count == 4) && (current_stepper->use_half_step == 0)) {
-    switch (this_step) {
-      case 0:    // 1100
-				GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-				break;
-      case 1:    // 0110
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_SetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-				break;
-			case 2:    //0011
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_SetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_SetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-				break;
-      case 3:    //1001
-      	GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_SetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-				break;
-    } 
-  }
-  if ((current_stepper->pin_count == 4) && (current_stepper->use_half_step == 1)) {
-    switch (this_step) {
-      case 0:    // 1000
-				GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-				break;
-      case 1:    // 1100
-				GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
-				break;
-      case 2:    // 0100
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
+	if((steps == 0) || (units == 0)){
+		current_stepper->unit_to_step_factor = 0;	// invalid ratio, all conversions return 0
+		current_stepper->step_to_unit_factor = 0;
+		current_stepper->unit_to_step_shift = 0;
+		current_stepper->step_to_unit_shift = 0;
+		return;
+	}
+	// units are Q16.16: steps = units * steps / (units << 16)
+	_stepper_unit_factor(steps, (uint64_t)units << 16, &current_stepper->unit_to_step_factor, &current_stepper->unit_to_step_shift);
+	_stepper_unit_factor((uint64_t)units << 16, steps, &current_stepper->step_to_unit_factor, &current_stepper->step_to_unit_shift);
+	current_stepper->unit_position = stepsToUnits(current_stepper, current_stepper->current_step_number);
+	current_stepper->unit_position_steps = current_stepper->current_step_number;
+}
+
+// Q16.16 user units to steps
+int32_t unitsToSteps(stepper_struct* current_stepper, int32_t units)
+{
+	return _stepper_unit_convert(units, current_stepper->unit_to_step_factor, current_stepper->unit_to_step_shift);
+}
+
+// steps to Q16.16 user units
+int32_t stepsToUnits(stepper_struct* current_stepper, int32_t steps)
+{
+	return _stepper_unit_convert(steps, current_stepper->step_to_unit_factor, current_stepper->step_to_unit_shift);
+}
+
+// speed in Q16.16 user units per second. Speed below 1 pulse per second is set to 1 pps.
+void setSpeedUnits(stepper_struct* current_stepper, uint32_t units_per_second)
+{
+	int32_t pulses_per_second = unitsToSteps(current_stepper, units_per_second);
+	
+	if(pulses_per_second < 1){
+		pulses_per_second = 1;
+	}
+	setSpeed(current_stepper, pulses_per_second);
+}
+
+// acceleration in Q16.16 user units per second^2 (STEP/DIR). 0 = no ramp, other values are at least 1 pulse/s^2.
+void setAccelerationUnits(stepper_struct* current_stepper, uint32_t units_per_second2)
+{
+	int32_t pulses_per_second2 = unitsToSteps(current_stepper, units_per_second2);
+	
+	if((units_per_second2 != 0) && (pulses_per_second2 < 1)){
+		pulses_per_second2 = 1;	// rounded to 0 would disable ramp
+	}
+	setAcceleration(current_stepper, pulses_per_second2);
+}
+
+/*
+	Blocking move to absolute position in Q16.16 user units.
+	Position is rounded to nearest step, unit position is kept for moveByUnits().
+*/
+void moveToUnits(stepper_struct* current_stepper, int32_t position)
+{
+	current_stepper->unit_position = position;
+	current_stepper->unit_position_steps = unitsToSteps(current_stepper, position);
+	current_stepper->target_step_number = current_stepper->unit_position_steps;
+	moveToTargetPos(current_stepper);
+}
+
+/*
+	Blocking relative move in Q16.16 user units.
+	Distance is added to last unit position, not to rounded step position - rounding remainder is carried to 
+	the next move and position doesn't drift.
+*/
+void moveByUnits(stepper_struct* current_stepper, int32_t distance)
+{
+	if(current_stepper->target_step_number != current_stepper->unit_position_steps){
+		// target was changed in steps (step(), setHomePos(), homing, ...)
+		current_stepper->unit_position = stepsToUnits(current_stepper, current_stepper->target_step_number);
+	}
+	moveToUnits(current_stepper, current_stepper->unit_position + distance);
+}
+
+// current position in Q16.16 user units
+int32_t getPositionUnits(stepper_struct* current_stepper)
+{
+	return stepsToUnits(current_stepper, current_stepper->current_step_number);
+}
+
+/*
+	numerator / denominator as factor / 2^shift. Largest shift is used that keeps factor < 2^31, so
+	relative error is < 2^-30 and value * factor fits in 64 bits.
+*/
+static void _stepper_unit_factor(uint64_t numerator, uint64_t denominator, uint32_t* factor, uint8_t* shift)
+{
+	uint8_t s = 0;
+	
+	while((s < 62) && (numerator < (1ULL << (62 - s))) && (((numerator << (s + 1)) / denominator) < 0x80000000UL)){
+		s++;
+	}
+	*factor = (numerator << s) / denominator;
+	*shift = s;
+}
+
+// (value * factor) >> shift, rounded to nearest
+static int32_t _stepper_unit_convert(int32_t value, uint32_t factor, uint8_t shift)
+{
+	int64_t result = (int64_t)value * factor;
+	
+	if(shift == 0){
+		return result;
+	}
+	return (result + (1LL << (shift - 1))) >> shift;
+}
+
+/*
+ * Moves the motor forward or backwards.
+ * this_step: 0 - (number_of_steps-1). Pins of each GPIO port are switched with single BSRR write.
+ */
+void stepMotor(stepper_struct* current_stepper, int this_step)
+{
+	uint32_t* phase;
+	
+	if(current_stepper->drive_mode == STEPPER_DRIVE_PWM){
+		_stepper_microstep(current_stepper, this_step);
+		return;
+	}
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		return;	// STEP pulses are generated by timer
+	}
+	phase = current_stepper->phase_bsrr[this_step];
+	current_stepper->phase_port[0]->BSRR = phase[0];
+	if(current_stepper->phase_port_count > 1){
+		uint8_t port;
+		for(port = 1; port < current_stepper->phase_port_count; port++){
+			current_stepper->phase_port[port]->BSRR = phase[port];
+		}
+	}
+}
+
+/*
+	Microstepping output: coil A current = cos, coil B current = sin of electrical angle.
+	this_step: 0 - (4*microsteps - 1) = one electrical cycle (4 full steps). Sine table has 32 entries per quarter cycle.
+*/
+static void _stepper_microstep(stepper_struct* current_stepper, uint8_t this_step)
+{
+	TIM_TypeDef* pwm_timer = current_stepper->pwm_timer;
+	uint8_t angle = (this_step << current_stepper->microstep_shift) & 0x7F;	// 0 - 127 = 0 - 360 deg
+	uint8_t index = angle & 0x1F;
+	uint16_t sine, cosine;
+	
+	if(angle & 0x20){	// 2. and 4. quarter
+		sine = microstep_sine[32 - index];
+		cosine = microstep_sine[index];
+	}
+	else{	// 1. and 3. quarter
+		sine = microstep_sine[index];
+		cosine = microstep_sine[32 - index];
+	}
+	sine = (sine * current_stepper->microstep_scale) >> 8;	// holding current
+	cosine = (cosine * current_stepper->microstep_scale) >> 8;
+	
+	switch(angle >> 5)
+	{
+		case 0:	// A+, B+
+			pwm_timer->CCR1 = cosine;	pwm_timer->CCR3 = 0;
+			pwm_timer->CCR2 = sine;		pwm_timer->CCR4 = 0;
+			break;
+		case 1:	// A-, B+
+			pwm_timer->CCR1 = 0;			pwm_timer->CCR3 = cosine;
+			pwm_timer->CCR2 = sine;		pwm_timer->CCR4 = 0;
+			break;
+		case 2:	// A-, B-
+			pwm_timer->CCR1 = 0;			pwm_timer->CCR3 = cosine;
+			pwm_timer->CCR2 = 0;			pwm_timer->CCR4 = sine;
+			break;
+		default:	// A+, B-
+			pwm_timer->CCR1 = cosine;	pwm_timer->CCR3 = 0;
+			pwm_timer->CCR2 = 0;			pwm_timer->CCR4 = sine;
+			break;
+	}
+}
+
+/*
+	Precalculate BSRR values for each step (depending on pin_count and use_half_step) and GPIO port. 
+	Lower 16 bits set pins, upper 16 bits reset pins of that port, so no transient (illegal) coil states 
+	appear between pins of the same port.
+*/
+static void _stepper_build_phase_table(stepper_struct* current_stepper)
+{
+	GPIO_TypeDef* pin_bank[4];
+	uint32_t pin[4];
+	const uint8_t* pattern;
+	uint8_t step, p, port;
+	
+	pin_bank[0] = current_stepper->motor_pin_1_bank;	pin[0] = current_stepper->motor_pin_1;
+	pin_bank[1] = current_stepper->motor_pin_2_bank;	pin[1] = current_stepper->motor_pin_2;
+	pin_bank[2] = current_stepper->motor_pin_3_bank;	pin[2] = current_stepper->motor_pin_3;
+	pin_bank[3] = current_stepper->motor_pin_4_bank;	pin[3] = current_stepper->motor_pin_4;
+	
+	if(current_stepper->pin_count == 2){
+		pattern = phase_pattern_2pin;
+	}
+	else if(current_stepper->use_half_step == USE_HALF_STEP){
+		pattern = phase_pattern_half;
+	}
+	else if(current_stepper->use_half_step == USE_WAVE_STEP){
+		pattern = phase_pattern_wave;
+	}
+	else{
+		pattern = phase_pattern_full;
+	}
+	
+	// list of different ports
+	current_stepper->phase_port_count = 0;
+	for(p = 0; p < current_stepper->pin_count; p++){
+		for(port = 0; port < current_stepper->phase_port_count; port++){
+			if(current_stepper->phase_port[port] == pin_bank[p]){
 				break;
-      case 3:    // 0110
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_SetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_SetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
+			}
+		}
+		if(port == current_stepper->phase_port_count){
+			current_stepper->phase_port[port] = pin_bank[p];
+			current_stepper->release_bsrr[port] = 0;
+			current_stepper->phase_port_count++;
+		}
+		current_stepper->release_bsrr[port] |= (pin[p] << 16);
+	}
+	
+	for(step = 0; step < current_stepper->number_of_steps; step++){
+		for(port = 0; port < current_stepper->phase_port_count; port++){
+			current_stepper->phase_bsrr[step][port] = 0;
+			for(p = 0; p < current_stepper->pin_count; p++){
+				if(pin_bank[p] == current_stepper->phase_port[port]){
+					if(pattern[step] & (1 << p)){
+						current_stepper->phase_bsrr[step][port] |= pin[p];					// set
+					}
+					else{
+						current_stepper->phase_bsrr[step][port] |= (pin[p] << 16);	// reset
+					}
+				}
+			}
+		}
+	}
+}
+
+/**********************************************************/
+/*	STEP/DIR PULSE GENERATOR */
+/**********************************************************/
+/*
+	Pulses are generated in blocks: each block is up to 256 STEP pulses with the same period (timer repetition 
+	counter). Timer period, repetition counter and pulse are preloaded, so the next block is written while the 
+	current block is generated, and the update interrupt (end of block) only preloads the block after it.
+	Acceleration ramp is divided into STEPPER_RAMP_SIZE blocks of equal speed change.
+*/
+
+// STEP period [timer ticks] for given speed
+static uint16_t _stepdir_period(uint32_t pulsesPerSecond)
+{
+	uint32_t period;
+	
+	if(pulsesPerSecond == 0){
+		pulsesPerSecond = 1;
+	}
+	period = STEPPER_STEPDIR_TIMER_FREQ / pulsesPerSecond;
+	if(period < 2 * STEPPER_STEPDIR_PULSE_WIDTH){
+		period = 2 * STEPPER_STEPDIR_PULSE_WIDTH;
+	}
+	if(period > 0xFFFF){
+		period = 0xFFFF;
+	}
+	return period;
+}
+
+// precalculate acceleration ramp: STEP period and number of pulses of each speed level
+static void _stepdir_build_ramp(stepper_struct* current_stepper)
+{
+	float start_speed = STEPPER_START_PPS;
+	float max_speed = current_stepper->speed_pps;
+	float speed_from, speed_to;
+	float pulses;
+	uint8_t block;
+	
+	current_stepper->cruise_period = _stepdir_period(current_stepper->speed_pps);
+	current_stepper->ramp_blocks = 0;
+	if((current_stepper->acceleration == 0) || (max_speed <= start_speed)){
+		return;
+	}
+	
+	for(block = 0; block < STEPPER_RAMP_SIZE; block++){
+		speed_from = start_speed + (max_speed - start_speed) * block / STEPPER_RAMP_SIZE;
+		speed_to = start_speed + (max_speed - start_speed) * (block + 1) / STEPPER_RAMP_SIZE;
+		pulses = (speed_to * speed_to - speed_from * speed_from) / (2.0f * current_stepper->acceleration) + 0.5f;
+		if(pulses < 1){
+			pulses = 1;
+		}
+		if(pulses > 256){
+			pulses = 256;
+		}
+		current_stepper->ramp_rcr[block] = (uint8_t)(pulses - 1);
+		current_stepper->ramp_period[block] = _stepdir_period((uint32_t)((speed_from + speed_to) / 2));
+	}
+	current_stepper->ramp_blocks = STEPPER_RAMP_SIZE;
+}
+
+// start generating steps_to_move pulses. Waits for previous move to finish.
+static void _stepdir_start(stepper_struct* current_stepper, int32_t steps_to_move)
+{
+	TIM_TypeDef* step_timer = current_stepper->pwm_timer;
+	uint32_t steps_left;
+	uint32_t accel_pulses = 0;
+	uint8_t blocks = 0;
+	uint16_t period, pulses;
+	
+	while(current_stepper->stepdir_moving);
+	steps_to_move = _stepper_soft_limit(current_stepper, current_stepper->current_step_number, steps_to_move);
+	if(_stepper_limit_blocked(current_stepper, steps_to_move) || (steps_to_move == 0)){
+		return;
+	}
+	
+	if(steps_to_move > 0){
+		current_stepper->direction = DIRECTION_CW;
+		reg_gpioSet(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
+		steps_left = steps_to_move;
+	}
+	else{
+		current_stepper->direction = DIRECTION_CCW;
+		reg_gpioReset(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
+		steps_left = -steps_to_move;
+	}
+	
+	// use as many ramp levels as possible, so that motor can also decelerate in the same number of pulses
+	while((blocks < current_stepper->ramp_blocks) && (2 * (accel_pulses + current_stepper->ramp_rcr[blocks] + 1) <= steps_left)){
+		accel_pulses += current_stepper->ramp_rcr[blocks] + 1;
+		blocks++;
+	}
+	current_stepper->stepdir_accel_blocks = blocks;
+	current_stepper->stepdir_cruise_left = steps_left - 2 * accel_pulses;
+	if(blocks == current_stepper->ramp_blocks){
+		current_stepper->stepdir_peak_period = current_stepper->cruise_period;
+	}
+	else if(blocks == 0){
+		current_stepper->stepdir_peak_period = current_stepper->ramp_period[0];
+	}
+	else{
+		current_stepper->stepdir_peak_period = current_stepper->ramp_period[blocks - 1];
+	}
+	current_stepper->stepdir_phase = STEPDIR_ACCELERATE;
+	current_stepper->stepdir_index = 0;
+	
+	// first block: load to shadow registers with software update event
+	pulses = _stepdir_next_block(current_stepper, &period);
+	reg_timSetPeriod(step_timer, period - 1);
+	step_timer->RCR = pulses - 1;
+	step_timer->CCR1 = STEPPER_STEPDIR_PULSE_WIDTH;
+	TIM_GenerateEvent(step_timer, TIM_EventSource_Update);
+	current_stepper->stepdir_block_pulses[0] = pulses;
+	
+	// second block: preload
+	_stepdir_preload_next(current_stepper);
+	
+	current_stepper->stepdir_moving = 1;
+	_stepdir_timestamp(&current_stepper->stepdir_block_ms, &current_stepper->stepdir_block_systick);
+	reg_timStart(step_timer);
+}
+
+// returns number of pulses of next block (0 = move finished) and its STEP period
+static uint16_t _stepdir_next_block(stepper_struct* current_stepper, uint16_t* period)
+{
+	uint16_t pulses;
+	
+	while(1){
+		switch(current_stepper->stepdir_phase)
+		{
+			case STEPDIR_ACCELERATE:
+				if(current_stepper->stepdir_index < current_stepper->stepdir_accel_blocks){
+					*period = current_stepper->ramp_period[current_stepper->stepdir_index];
+					pulses = current_stepper->ramp_rcr[current_stepper->stepdir_index] + 1;
+					current_stepper->stepdir_index++;
+					return pulses;
+				}
+				current_stepper->stepdir_phase = STEPDIR_CRUISE;
 				break;
-      case 4:    //0010
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_SetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_ResetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
+			
+			case STEPDIR_CRUISE:
+				if(current_stepper->stepdir_cruise_left != 0){
+					pulses = 256;
+					if(current_stepper->stepdir_cruise_left < 256){
+						pulses = current_stepper->stepdir_cruise_left;
+					}
+					current_stepper->stepdir_cruise_left -= pulses;
+					*period = current_stepper->stepdir_peak_period;
+					return pulses;
+				}
+				current_stepper->stepdir_phase = STEPDIR_DECELERATE;
 				break;
-      case 5:    //0011
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_SetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_SetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
+			
+			case STEPDIR_DECELERATE:
+				if(current_stepper->stepdir_index != 0){
+					current_stepper->stepdir_index--;
+					*period = current_stepper->ramp_period[current_stepper->stepdir_index];
+					return current_stepper->ramp_rcr[current_stepper->stepdir_index] + 1;
+				}
+				current_stepper->stepdir_phase = STEPDIR_DONE;
 				break;
-      case 6:    //0001
-				GPIO_ResetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_SetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
+			
+			default:
+				return 0;
+		}
+	}
+}
+
+// write next block to preload registers. After last block, an empty block (no STEP pulse) is preloaded.
+static void _stepdir_preload_next(stepper_struct* current_stepper)
+{
+	TIM_TypeDef* step_timer = current_stepper->pwm_timer;
+	uint16_t period;
+	uint16_t pulses = _stepdir_next_block(current_stepper, &period);
+	
+	if(pulses == 0){
+		step_timer->CCR1 = 0;
+	}
+	else{
+		reg_timSetPeriod(step_timer, period - 1);
+		step_timer->RCR = pulses - 1;
+		step_timer->CCR1 = STEPPER_STEPDIR_PULSE_WIDTH;
+	}
+	current_stepper->stepdir_block_pulses[1] = pulses;
+}
+
+// end of block: update position, stop after last block or preload the block after next
+static void _stepdir_update(stepper_struct* current_stepper)
+{
+	if(current_stepper->direction == DIRECTION_CW){
+		current_stepper->current_step_number += current_stepper->stepdir_block_pulses[0];
+	}
+	else{
+		current_stepper->current_step_number -= current_stepper->stepdir_block_pulses[0];
+	}
+	current_stepper->stepdir_block_pulses[0] = current_stepper->stepdir_block_pulses[1];
+	
+	if(current_stepper->stepdir_block_pulses[0] == 0){	// empty block started - move finished
+		reg_timStop(current_stepper->pwm_timer);
+		current_stepper->stepdir_moving = 0;
+		return;
+	}
+	_stepdir_timestamp(&current_stepper->stepdir_block_ms, &current_stepper->stepdir_block_systick);
+	_stepdir_preload_next(current_stepper);
+}
+
+// current time: millis() and SysTick->VAL. SysTick reload not yet counted in millis() (pending interrupt) is added.
+static void _stepdir_timestamp(uint32_t* ms, uint32_t* systick)
+{
+	atomic_enter();
+	*ms = millis();
+	*systick = SysTick->VAL;
+	if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk){
+		*ms += 1;
+		*systick = SysTick->VAL;
+	}
+	atomic_exit();
+}
+
+/*
+	Limit switch: stop STEP pulses immediately. Repetition counter of the timer can't be read, so pulses of 
+	current block that were already generated are calculated from time since block start and CNT (position 
+	in current STEP period, pulse is generated at the start of each period).
+*/
+static void _stepdir_abort(stepper_struct* current_stepper)
+{
+	TIM_TypeDef* step_timer = current_stepper->pwm_timer;
+	uint32_t ms, systick;
+	uint32_t counter, period, pulses;
+	int32_t elapsed;
+	int32_t systick_period = STEPPER_STEPDIR_TIMER_FREQ / 1000000 * INCREMENT_RESOLUTION;	// [STEP timer ticks]
+	
+	reg_timStop(step_timer);
+	counter = step_timer->CNT;
+	period = step_timer->ARR + 1;
+	
+	if(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk){
+		_stepdir_timestamp(&ms, &systick);
+		// elapsed time in STEP timer ticks. SysTick counts down from LOAD to 0 every INCREMENT_RESOLUTION us
+		elapsed = (int32_t)(ms - current_stepper->stepdir_block_ms) * systick_period;
+		elapsed += ((int32_t)current_stepper->stepdir_block_systick - (int32_t)systick) * systick_period / (int32_t)(SysTick->LOAD + 1);
+		// completed periods (rounded: block start time stamp is taken with interrupt latency) + pulse of current period
+		pulses = 1;
+		if(elapsed > (int32_t)counter){
+			pulses += (elapsed - counter + period / 2) / period;
+		}
+		if(pulses > current_stepper->stepdir_block_pulses[0]){
+			pulses = current_stepper->stepdir_block_pulses[0];
+		}
+	}
+	else{	// no time base: position within block is unknown
+		pulses = 0;
+		current_stepper->lost_steps += current_stepper->stepdir_block_pulses[0];
+	}
+	
+	if(current_stepper->direction == DIRECTION_CW){
+		current_stepper->current_step_number += pulses;
+	}
+	else{
+		current_stepper->current_step_number -= pulses;
+	}
+	current_stepper->stepdir_block_pulses[0] = 0;
+	current_stepper->stepdir_moving = 0;
+}
+
+void TIM15_IRQHandler()
+{
+	if (reg_timUpdatePending(TIM15))
+  {
+		reg_timClearUpdate(TIM15);
+		if(stepdir_tim15_stepper != 0){
+			_stepdir_update(stepdir_tim15_stepper);
+		}
+	}
+}
+
+void TIM17_IRQHandler()
+{
+	if (reg_timUpdatePending(TIM17))
+  {
+		reg_timClearUpdate(TIM17);
+		if(stepdir_tim17_stepper != 0){
+			_stepdir_update(stepdir_tim17_stepper);
+		}
+	}
+}
+
+/**********************************************************/
+/*	MOTION ENGINE */
+/**********************************************************/
+/*
+	Set axes driven by motion engine. Axes must be initialized with stepperInit_2pin()/stepperInit_4pin().
+	axes: array of pointers to stepper structures. Index in this array is axis number in stepperQueueMove().
+	axis_count: 1 - STEPPER_MAX_AXES
+*/
+void stepperEngineInit(stepper_struct** axes, uint8_t axis_count)
+{
+	uint8_t axis;
+	
+	if(axis_count > STEPPER_MAX_AXES){
+		axis_count = STEPPER_MAX_AXES;
+	}
+	
+	timer16_engine_init();
+	engine_running = 0;
+	engine_segment = 0;
+	engine_exit_rate = 0;
+	atomic_ringInit(&engine_ring, STEPPER_QUEUE_SIZE);
+	engine_rate_accumulator = (STEPPER_TICK_FREQ << 8);
+	
+	for(axis = 0; axis < axis_count; axis++){
+		engine_axes[axis] = axes[axis];
+		engine_planned_position[axis] = axes[axis]->current_step_number;
+	}
+	engine_axis_count = axis_count;
+}
+
+/*
+	Set acceleration for moves queued after this call.
+	acceleration: [pulses/s^2] of the axis with most steps. 0 = no ramps, move with constant speed.
+	jerk: max instant speed change of any axis at junction of two moves [pulses per second]
+*/
+void stepperSetAcceleration(uint32_t acceleration, uint32_t jerk)
+{
+	engine_acceleration = acceleration;
+	engine_jerk = jerk;
+}
+
+/*
+	Queue relative move of all axes. 
+	steps: array of engine_axis_count step numbers. +CW, -CCW. 
+		Steps are shortened to stay within soft limits, moves towards pressed limit switch are removed 
+		(in queued copy, steps array is not modified).
+	pulsesPerSecond: speed of the axis with most steps. Other axes are slower, so all axes finish together.
+	Returns 1 if move was queued, 0 if queue is full.
+*/
+uint8_t stepperQueueMove(const int32_t* steps, uint32_t pulsesPerSecond)
+{
+	stepper_segment_t* segment;
+	stepper_segment_t* previous;
+	uint8_t head = atomic_ringHead(&engine_ring);
+	uint8_t axis;
+	int32_t clipped[STEPPER_MAX_AXES];	// steps within soft limits
+	uint32_t profile[4];
+	float junction_speed;
+	float axis_speed_change;
+	
+	if(atomic_ringFull(&engine_ring)){
+		return 0;	// queue is full
+	}
+	
+	segment = &engine_queue[head];
+	segment->direction_bits = 0;
+	segment->step_event_count = 0;
+	for(axis = 0; axis < engine_axis_count; axis++){
+		clipped[axis] = _stepper_soft_limit(engine_axes[axis], engine_planned_position[axis], steps[axis]);
+		if(_stepper_limit_blocked(engine_axes[axis], clipped[axis])){
+			clipped[axis] = 0;
+		}
+		if(clipped[axis] >= 0){
+			segment->direction_bits |= (1 << axis);
+			segment->steps[axis] = clipped[axis];
+		}
+		else{
+			segment->steps[axis] = -clipped[axis];
+		}
+		if(segment->steps[axis] > segment->step_event_count){
+			segment->step_event_count = segment->steps[axis];
+		}
+	}
+	if(segment->step_event_count == 0){
+		return 1;	// nothing to move
+	}
+	
+	// limit speed so that no axis exceeds its max_speed
+	if(pulsesPerSecond == 0){
+		pulsesPerSecond = 1;
+	}
+	for(axis = 0; axis < engine_axis_count; axis++){
+		if((engine_axes[axis]->max_speed != 0) && (segment->steps[axis] != 0)){
+			if((uint64_t)pulsesPerSecond * segment->steps[axis] > (uint64_t)engine_axes[axis]->max_speed * segment->step_event_count){
+				pulsesPerSecond = ((uint64_t)engine_axes[axis]->max_speed * segment->step_event_count) / segment->steps[axis];
+			}
+		}
+	}
+	if(pulsesPerSecond == 0){
+		pulsesPerSecond = 1;
+	}
+	if(pulsesPerSecond > STEPPER_TICK_FREQ){
+		pulsesPerSecond = STEPPER_TICK_FREQ;
+	}
+	segment->nominal_speed = pulsesPerSecond;
+	segment->nominal_rate = pulsesPerSecond << 8;
+	segment->hold_ticks = STEPPER_TICK_FREQ / pulsesPerSecond;
+	
+	/* 	Junction speed with previous queued move: both moves are executed with the same rate of the axis with 
+		most steps, speed of each axis changes with direction/ratio of moves. Limit it to jerk. */
+	segment->max_entry_speed = 0;
+	if(!atomic_ringEmpty(&engine_ring)){
+		previous = &engine_queue[(head - 1) & (STEPPER_QUEUE_SIZE - 1)];
+		junction_speed = segment->nominal_speed;
+		if(previous->nominal_speed < junction_speed){
+			junction_speed = previous->nominal_speed;
+		}
+		for(axis = 0; axis < engine_axis_count; axis++){
+			axis_speed_change = (float)segment->steps[axis] / segment->step_event_count;
+			if(!(segment->direction_bits & (1 << axis))){
+				axis_speed_change = -axis_speed_change;
+			}
+			if(previous->direction_bits & (1 << axis)){
+				axis_speed_change -= (float)previous->steps[axis] / previous->step_event_count;
+			}
+			else{
+				axis_speed_change += (float)previous->steps[axis] / previous->step_event_count;
+			}
+			if(axis_speed_change < 0){
+				axis_speed_change = -axis_speed_change;
+			}
+			if(axis_speed_change * junction_speed > engine_jerk){
+				junction_speed = engine_jerk / axis_speed_change;
+			}
+		}
+		segment->max_entry_speed = junction_speed;
+	}
+	segment->entry_speed = 0;
+	
+	// safe profile (start and stop at the end of segment), interrupt routine can start segment before planner joins it with previous one
+	_stepper_segment_profile(segment, 0, 0, profile);
+	segment->initial_rate = profile[0];
+	segment->final_rate = profile[1];
+	segment->rate_delta = _stepper_rate_delta();
+	segment->accelerate_until = profile[2];
+	segment->decelerate_after = profile[3];
+	
+	for(axis = 0; axis < engine_axis_count; axis++){
+		engine_planned_position[axis] += clipped[axis];
+	}
+	
+	atomic_ringPush(&engine_ring);	// segment is ready for interrupt routine
+	_stepper_planner_recalculate();
+	if(engine_running == 0){
+		engine_running = 1;
+		reg_timSetCounter(TIM16, 0);
+		reg_timStart(TIM16);
+	}
+	return 1;
+}
+
+/*
+	Queue move of all axes to their target_step_number (relative to the end of already queued moves).
+	Returns 1 if move was queued, 0 if queue is full.
+*/
+uint8_t stepperQueueTargetPos(uint32_t pulsesPerSecond)
+{
+	int32_t steps[STEPPER_MAX_AXES];
+	uint8_t axis;
+	
+	for(axis = 0; axis < engine_axis_count; axis++){
+		steps[axis] = engine_axes[axis]->target_step_number - engine_planned_position[axis];
+	}
+	return stepperQueueMove(steps, pulsesPerSecond);
+}
+
+// returns 1 while motion queue is not empty or any axis is still moving
+uint8_t stepperEngineBusy(void)
+{
+	return engine_running;
+}
+
+// wait until all queued moves are finished
+void stepperEngineWait(void)
+{
+	while(engine_running);
+}
+
+// stop immediately, discard all queued moves and reset motor pins
+void stepperEngineStop(void)
+{
+	uint8_t axis;
+	
+	reg_timStop(TIM16);
+	engine_running = 0;
+	engine_segment = 0;
+	engine_exit_rate = 0;
+	engine_rate_accumulator = (STEPPER_TICK_FREQ << 8);
+	engine_ring.tail = engine_ring.head;	// timer is stopped: queue is emptied
+	
+	for(axis = 0; axis < engine_axis_count; axis++){
+		engine_planned_position[axis] = engine_axes[axis]->current_step_number;
+		engine_axes[axis]->power_state = STEPPER_POWER_OFF;
+		_stepper_release(engine_axes[axis]);
+	}
+}
+
+/*
+	Look-ahead planner. Called from main loop after each queued move.
+	Plans entry speeds of all segments that are not executed yet: backward pass limits entry speed so 
+	that motor can decelerate to stop at the end of the queue, forward pass limits it to speed reachable
+	from previous segment. Then velocity profiles (trapezoids) are calculated for interrupt routine.
+	Floats are used only here (main loop), interrupt routine uses precalculated integer rates.
+*/
+static void _stepper_planner_recalculate(void)
+{
+	uint32_t profile[STEPPER_QUEUE_SIZE][4];
+	stepper_segment_t* segment;
+	uint8_t first, tail, index, next;
+	uint8_t head = atomic_ringHead(&engine_ring);
+	uint32_t exit_rate;
+	uint32_t rate_delta;
+	float two_acceleration;
+	float exit_speed, max_speed;
+	
+	if(engine_acceleration == 0){	// no ramps: constant speed
+		index = atomic_ringTail(&engine_ring);
+		while(index != head){
+			segment = &engine_queue[index];
+			atomic_enter();
+			if(segment != engine_segment){
+				segment->initial_rate = segment->nominal_rate;
+				segment->final_rate = segment->nominal_rate;
+				segment->rate_delta = 0;
+				segment->accelerate_until = 0;
+				segment->decelerate_after = segment->step_event_count;
+			}
+			atomic_exit();
+			index = (index + 1) & (STEPPER_QUEUE_SIZE - 1);
+		}
+		return;
+	}
+	rate_delta = _stepper_rate_delta();
+	// plan with acceleration that interrupt routine actually applies (rate_delta is truncated)
+	two_acceleration = 2.0f * rate_delta * STEPPER_TICK_FREQ / 256;
+	
+	while(1){
+		// snapshot of interrupt routine state: first segment that can be replanned and its max entry rate
+		atomic_enter();
+		tail = atomic_ringTail(&engine_ring);
+		first = tail;
+		if(engine_segment != 0){
+			first = (tail + 1) & (STEPPER_QUEUE_SIZE - 1);
+		}
+		exit_rate = engine_exit_rate;
+		atomic_exit();
+		
+		if(first == head){
+			return;	// all segments are already executing
+		}
+		
+		// backward pass: motor must be able to stop at the end of queue
+		exit_speed = 0;
+		index = head;
+		do{
+			index = (index - 1) & (STEPPER_QUEUE_SIZE - 1);
+			segment = &engine_queue[index];
+			max_speed = sqrtf(exit_speed * exit_speed + two_acceleration * segment->step_event_count);
+			segment->entry_speed = segment->max_entry_speed;
+			if(segment->entry_speed > max_speed){
+				segment->entry_speed = max_speed;
+			}
+			exit_speed = segment->entry_speed;
+		} while(index != first);
+		
+		// forward pass: entry speed must be reachable from previous segment
+		segment = &engine_queue[first];
+		if(segment->entry_speed > (float)exit_rate / 256){
+			segment->entry_speed = (float)exit_rate / 256;
+		}
+		index = first;
+		while(1){
+			segment = &engine_queue[index];
+			next = (index + 1) & (STEPPER_QUEUE_SIZE - 1);
+			if(next == head){
 				break;
-      case 7:    //1001
-				GPIO_SetBits(current_stepper->motor_pin_1_bank, current_stepper->motor_pin_1);
-				GPIO_ResetBits(current_stepper->motor_pin_2_bank, current_stepper->motor_pin_2);
-				GPIO_ResetBits(current_stepper->motor_pin_3_bank, current_stepper->motor_pin_3);
-				GPIO_SetBits(current_stepper->motor_pin_4_bank, current_stepper->motor_pin_4);
+			}
+			max_speed = sqrtf(segment->entry_speed * segment->entry_speed + two_acceleration * segment->step_event_count);
+			if(engine_queue[next].entry_speed > max_speed){
+				engine_queue[next].entry_speed = max_speed;
+			}
+			index = next;
+		}
+		
+		// velocity profiles
+		index = first;
+		while(index != head){
+			next = (index + 1) & (STEPPER_QUEUE_SIZE - 1);
+			exit_speed = 0;
+			if(next != head){
+				exit_speed = engine_queue[next].entry_speed;
+			}
+			_stepper_segment_profile(&engine_queue[index], engine_queue[index].entry_speed, exit_speed, profile[index]);
+			index = next;
+		}
+		
+		// commit profiles, if interrupt routine didn't start first segment in the meantime
+		atomic_enter();
+		if((tail != atomic_ringTail(&engine_ring)) || ((first == tail) && (engine_segment != 0))){
+			atomic_exit();
+			continue;	// replan
+		}
+		index = first;
+		while(index != head){
+			segment = &engine_queue[index];
+			segment->initial_rate = profile[index][0];
+			segment->final_rate = profile[index][1];
+			segment->rate_delta = rate_delta;
+			segment->accelerate_until = profile[index][2];
+			segment->decelerate_after = profile[index][3];
+			index = (index + 1) & (STEPPER_QUEUE_SIZE - 1);
+		}
+		atomic_exit();
+		return;
+	}
+}
+
+// rate change per interrupt routine tick (rate is in steps per second * 256)
+static uint32_t _stepper_rate_delta(void)
+{
+	uint32_t rate_delta;
+	
+	if(engine_acceleration == 0){
+		return 0;
+	}
+	rate_delta = (engine_acceleration << 8) / STEPPER_TICK_FREQ;
+	if(rate_delta == 0){
+		rate_delta = 1;
+	}
+	return rate_delta;
+}
+
+/*
+	Velocity profile (trapezoid) of segment from entry_speed to exit_speed [steps/s].
+	profile[]: initial rate, final rate, accelerate until step, decelerate after step.
+	Without acceleration, segment is executed with constant nominal rate.
+*/
+static void _stepper_segment_profile(stepper_segment_t* segment, float entry_speed, float exit_speed, uint32_t* profile)
+{
+	float two_acceleration = 2.0f * _stepper_rate_delta() * STEPPER_TICK_FREQ / 256;
+	float start_speed;
+	int32_t accel_steps, decel_steps;
+	
+	if(engine_acceleration == 0){
+		profile[0] = segment->nominal_rate;
+		profile[1] = segment->nominal_rate;
+		profile[2] = 0;
+		profile[3] = segment->step_event_count;
+		return;
+	}
+	
+	// motor can always start/stop with STEPPER_START_PPS
+	start_speed = STEPPER_START_PPS;
+	if(start_speed > segment->nominal_speed){
+		start_speed = segment->nominal_speed;
+	}
+	if(entry_speed < start_speed){
+		entry_speed = start_speed;
+	}
+	if(exit_speed < start_speed){
+		exit_speed = start_speed;
+	}
+	
+	accel_steps = (int32_t)ceilf((segment->nominal_speed * segment->nominal_speed - entry_speed * entry_speed) / two_acceleration);
+	decel_steps = (int32_t)floorf((segment->nominal_speed * segment->nominal_speed - exit_speed * exit_speed) / two_acceleration);
+	if(accel_steps + decel_steps > (int32_t)segment->step_event_count){	// nominal speed is not reached
+		accel_steps = (int32_t)ceilf((two_acceleration * segment->step_event_count + exit_speed * exit_speed - entry_speed * entry_speed) / (2.0f * two_acceleration));
+		if(accel_steps < 0){
+			accel_steps = 0;
+		}
+		if(accel_steps > (int32_t)segment->step_event_count){
+			accel_steps = segment->step_event_count;
+		}
+		decel_steps = segment->step_event_count - accel_steps;
+	}
+	profile[0] = (uint32_t)(entry_speed * 256);
+	profile[1] = (uint32_t)(exit_speed * 256);
+	profile[2] = accel_steps;
+	profile[3] = segment->step_event_count - decel_steps;
+}
+
+/*
+	Motion engine interrupt routine, called every 1/STEPPER_TICK_FREQ s.
+	Rate accumulator generates steps of the axis with most steps (step event), other axes are stepped
+	with Bresenham algorithm, so all axes of segment start and finish together. Rate is changed on every 
+	tick according to segment velocity profile. Next segment continues without stop.
+*/
+static void _stepper_engine_tick(void)
+{
+	uint8_t axis;
+	stepper_segment_t* segment = engine_segment;
+	
+	if(engine_abort){	// limit switch pressed: stop all axes
+		engine_abort = 0;
+		stepperEngineStop();
+		return;
+	}
+	
+	if(segment == 0){
+		if(atomic_ringEmpty(&engine_ring)){	// queue empty
+			if(engine_hold_countdown != 0){
+				engine_hold_countdown--;
+				return;
+			}
+			for(axis = 0; axis < engine_axis_count; axis++){
+				if(engine_axes[axis]->power_managed == 0){
+					_stepper_release(engine_axes[axis]);
+				}
+			}
+			reg_timStop(TIM16);
+			engine_running = 0;
+			return;
+		}
+		// start new segment
+		segment = &engine_queue[atomic_ringTail(&engine_ring)];
+		for(axis = 0; axis < engine_axis_count; axis++){
+			engine_counter[axis] = -(int32_t)(segment->step_event_count >> 1);
+			_stepper_power_busy(engine_axes[axis]);
+		}
+		engine_step_events_completed = 0;
+		engine_rate = segment->initial_rate;
+		engine_exit_rate = segment->final_rate;
+		engine_segment = segment;
+	}
+	
+	// velocity profile
+	if(engine_step_events_completed < segment->accelerate_until){
+		engine_rate += segment->rate_delta;
+		if(engine_rate > segment->nominal_rate){
+			engine_rate = segment->nominal_rate;
+		}
+	}
+	else if(engine_step_events_completed >= segment->decelerate_after){
+		if(engine_rate > segment->final_rate + segment->rate_delta){
+			engine_rate -= segment->rate_delta;
+		}
+		else{
+			engine_rate = segment->final_rate;
+		}
+	}
+	else{
+		engine_rate = segment->nominal_rate;
+	}
+	
+	engine_rate_accumulator += engine_rate;
+	if(engine_rate_accumulator < (STEPPER_TICK_FREQ << 8)){
+		return;
+	}
+	engine_rate_accumulator -= (STEPPER_TICK_FREQ << 8);
+	
+	for(axis = 0; axis < engine_axis_count; axis++){
+		engine_counter[axis] += segment->steps[axis];
+		if(engine_counter[axis] > 0){
+			engine_counter[axis] -= segment->step_event_count;
+			if(segment->direction_bits & (1 << axis)){
+				_stepper_single_step(engine_axes[axis], DIRECTION_CW);
+			}
+			else{
+				_stepper_single_step(engine_axes[axis], DIRECTION_CCW);
+			}
+		}
+	}
+	
+	engine_step_events_completed++;
+	if(engine_step_events_completed >= segment->step_event_count){	// segment finished
+		engine_hold_countdown = segment->hold_ticks;
+		engine_segment = 0;
+		atomic_ringPop(&engine_ring);
+		if(atomic_ringEmpty(&engine_ring)){	// no more moves - release axes which don't maintain position
+			engine_exit_rate = 0;
+			engine_rate_accumulator = (STEPPER_TICK_FREQ << 8);	// next move starts with step
+			for(axis = 0; axis < engine_axis_count; axis++){
+				if(engine_axes[axis]->power_managed){
+					_stepper_power_idle(engine_axes[axis]);	// settle, hold, release in TIM14 interrupt
+				}
+				else if(engine_axes[axis]->maintain_position != MAINTAIN_POS){
+					_stepper_release(engine_axes[axis]);
+				}
+			}
+		}
+	}
+}
+
+// make one step in given direction and update step counters
+static void _stepper_single_step(stepper_struct* current_stepper, direction_t direction)
+{
+	current_stepper->direction = direction;
+	if(direction == DIRECTION_CW){
+		current_stepper->current_step_number++;
+		current_stepper->step_number++;
+		if(current_stepper->step_number >= current_stepper->number_of_steps){
+			current_stepper->step_number = 0;
+		}
+	}
+	else{
+		current_stepper->current_step_number--;
+		if(current_stepper->step_number == 0){
+			current_stepper->step_number = current_stepper->number_of_steps;
+		}
+		current_stepper->step_number--;
+	}
+	stepMotor(current_stepper, current_stepper->step_number);
+}
+
+// end of blocking move: hand coils to power manager or hold for one step delay (MAINTAIN_POS) and reset motor pins
+static void _stepper_move_done(stepper_struct* current_stepper)
+{
+	if(current_stepper->power_managed){
+		_stepper_power_idle(current_stepper);
+		return;
+	}
+	if (current_stepper->maintain_position == MAINTAIN_POS){	//add aditional step delay, before pins are reseted
+		atomic_flagClear(&TIM16_update_flag);
+		reg_timSetCounter(TIM16, 0);
+		reg_timStart(TIM16);
+		while(atomic_flagTake(&TIM16_update_flag) == 0);
+		reg_timStop(TIM16);
+	}
+	_stepper_release(current_stepper);
+}
+
+// move starts: power manager stops holding, full current
+static void _stepper_power_busy(stepper_struct* current_stepper)
+{
+	current_stepper->power_state = STEPPER_POWER_MOVING;
+	current_stepper->microstep_scale = 256;
+}
+
+// move finished: full current for settle time, then holding current (TIM14 interrupt)
+static void _stepper_power_idle(stepper_struct* current_stepper)
+{
+	current_stepper->power_countdown = current_stepper->hold_settle_ticks;
+	current_stepper->power_state = STEPPER_POWER_SETTLE;
+	reg_timStart(TIM14);
+}
+
+// settle time elapsed: reduce current or release coils
+static void _stepper_power_hold(stepper_struct* current_stepper)
+{
+	if(current_stepper->hold_chop == 0){
+		_stepper_release(current_stepper);
+		current_stepper->power_state = STEPPER_POWER_OFF;
+		return;
+	}
+	current_stepper->power_countdown = current_stepper->hold_timeout_ticks;
+	current_stepper->power_state = STEPPER_POWER_HOLD;
+	if(current_stepper->drive_mode == STEPPER_DRIVE_PWM){
+		current_stepper->microstep_scale = current_stepper->hold_scale;
+		_stepper_microstep(current_stepper, current_stepper->step_number);
+	}
+}
+
+// TIM14: power management time base. Same priority as step interrupts, so coil writes never interleave.
+static void _stepper_power_timer_init(void)
+{
+	TIM_TimeBaseInitTypeDef timer14;
+	RCC_ClocksTypeDef system_freq;
+	NVIC_InitTypeDef timer14_int;
+	
+	RCC_GetClocksFreq(&system_freq);	//get system clocks
+	
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM14, ENABLE);
+	timer14.TIM_Prescaler = (system_freq.HCLK_Frequency / 1000000) - 1;	// 1us timer increment
+	timer14.TIM_CounterMode = TIM_CounterMode_Up;
+	timer14.TIM_Period = (1000000 / STEPPER_POWER_TICK_FREQ) - 1;
+	timer14.TIM_ClockDivision = TIM_CKD_DIV1;
+	timer14.TIM_RepetitionCounter = 0;
+	TIM_TimeBaseInit(TIM14, &timer14);
+	
+	timer14_int.NVIC_IRQChannel = TIM14_IRQn;
+	timer14_int.NVIC_IRQChannelPriority = 1;
+	timer14_int.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&timer14_int);
+	
+	TIM_ClearITPendingBit(TIM14, TIM_IT_Update);
+	TIM_ITConfig(TIM14, TIM_IT_Update, ENABLE);
+	TIM_Cmd(TIM14, DISABLE);
+}
+
+/*
+	Power management tick: settle and idle timeouts, GPIO coil chopping (on for hold_chop of STEPPER_CHOP_STEPS
+	ticks). Timer is stopped when no stepper needs it.
+*/
+void TIM14_IRQHandler()
+{
+	stepper_struct* current_stepper;
+	uint8_t i;
+	uint8_t active = 0;
+	
+	if (reg_timUpdatePending(TIM14))
+  {
+		reg_timClearUpdate(TIM14);
+		
+		power_chop_phase++;
+		if(power_chop_phase >= STEPPER_CHOP_STEPS){
+			power_chop_phase = 0;
+		}
+		
+		for(i = 0; i < (STEPPER_MAX_AXES + 1); i++){
+			current_stepper = power_steppers[i];
+			if(current_stepper == 0){
 				break;
-    } 
-  }
+			}
+			if(current_stepper->power_state == STEPPER_POWER_SETTLE){
+				active = 1;
+				if(current_stepper->power_countdown != 0){
+					current_stepper->power_countdown--;
+				}
+				else{
+					_stepper_power_hold(current_stepper);
+				}
+			}
+			else if(current_stepper->power_state == STEPPER_POWER_HOLD){
+				if((current_stepper->drive_mode == STEPPER_DRIVE_GPIO) && (current_stepper->hold_chop < STEPPER_CHOP_STEPS)){
+					active = 1;
+					if(power_chop_phase == 0){
+						stepMotor(current_stepper, current_stepper->step_number);	// coils on
+					}
+					else if(power_chop_phase == current_stepper->hold_chop){
+						_stepper_release(current_stepper);	// coils off
+					}
+				}
+				if(current_stepper->hold_timeout_ticks != 0){
+					active = 1;
+					current_stepper->power_countdown--;
+					if(current_stepper->power_countdown == 0){	// idle timeout
+						_stepper_release(current_stepper);
+						current_stepper->power_state = STEPPER_POWER_OFF;
+					}
+				}
+			}
+		}
+		if(active == 0){
+			reg_timStop(TIM14);
+		}
+	}
 }
 
+// reset motor pins
+static void _stepper_release(stepper_struct* current_stepper)
+{
+	uint8_t port;
+	
+	if(current_stepper->drive_mode == STEPPER_DRIVE_PWM){
+		current_stepper->pwm_timer->CCR1 = 0;
+		current_stepper->pwm_timer->CCR2 = 0;
+		current_stepper->pwm_timer->CCR3 = 0;
+		current_stepper->pwm_timer->CCR4 = 0;
+		return;
+	}
+	if(current_stepper->drive_mode == STEPPER_DRIVE_STEPDIR){
+		return;	// external driver holds position
+	}
+	for(port = 0; port < current_stepper->phase_port_count; port++){
+		current_stepper->phase_port[port]->BSRR = current_stepper->release_bsrr[port];
+	}
+}
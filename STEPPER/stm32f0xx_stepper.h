@@ -20,20 +20,62 @@
 #include <stm32f0xx_tim.h>
 #include <stm32f0xx_misc.h>
 #include <stm32f0xx_gpio_init.h>
+#include <stm32f0xx_reg.h>
+#include <stm32f0xx_atomic.h>
+#include <systick_millis.h>
 
 #ifdef __cplusplus
   extern "C" {
 #endif
 
 //other driver defines
-#define USE_HALF_STEP	1
+#define USE_FULL_STEP	0		// two coils energized
+#define USE_HALF_STEP	1		// one/two coils energized, 8 steps (only 4-wire)
+#define USE_WAVE_STEP	2		// one coil energized, less torque and current (only 4-wire)
 #define MAINTAIN_POS	1
 #define DONT_MAINTAIN_POS	0
 		
+//microstepping PWM config
+#define STEPPER_PWM_FREQ			20000		// PWM frequency of coil pins [Hz] (above audible range if core clock allows)
+#define STEPPER_PWM_PERIOD		1000		// PWM timer period = 100% duty (sine table amplitude)
+
+//STEP/DIR config (external driver: A4988, DRV8825, TMC...)
+#define STEPPER_STEPDIR_TIMER_FREQ	2000000		// STEP timer clock [Hz]. Min speed = STEPPER_STEPDIR_TIMER_FREQ / 65536
+#define STEPPER_STEPDIR_PULSE_WIDTH	4					// STEP pulse width [timer ticks] = 2us
+#define STEPPER_RAMP_SIZE			32			// number of speed levels in acceleration ramp
+
+//limit switches
+#define STEPPER_MAX_LIMIT_SWITCHES	4		// number of steppers with limit switch (stepperLimitInit)
+
+//coil power management (stepperPowerInit): TIM14 time base, GPIO coils chopped in STEPPER_CHOP_STEPS ticks
+#define STEPPER_POWER_TICK_FREQ	16000		// [Hz]
+#define STEPPER_CHOP_STEPS			8				// chopping frequency = STEPPER_POWER_TICK_FREQ / STEPPER_CHOP_STEPS = 2 kHz
+
+//power_state
+#define STEPPER_POWER_OFF				0				// coils released
+#define STEPPER_POWER_MOVING		1				// full current, move in progress
+#define STEPPER_POWER_SETTLE		2				// full current for settle time after move
+#define STEPPER_POWER_HOLD			3				// reduced holding current until idle timeout
+
+//user units: positions, speeds and accelerations in Q16.16 fixed point (16 integer, 16 fractional bits)
+//range is +/-32767 units: positions in degrees are limited to +/-91 revolutions. Use larger units (revolutions, mm) for longer travel.
+#define STEPPER_Q16(x)			((int32_t)((x) * 65536.0))	// constant to Q16.16, example: STEPPER_Q16(12.5)
+
+//drive modes (set by stepperInit_ functions)
+#define STEPPER_DRIVE_GPIO		0				// coils switched on/off with GPIO pins
+#define STEPPER_DRIVE_PWM			1				// microstepping: coils driven with timer PWM
+#define STEPPER_DRIVE_STEPDIR	2				// external driver: STEP pulses generated by timer, DIR pin
+
 //timer config		
 #define TIM16_INCREMENT_RESOLUTION	125	// in microseconds [us]. Timer increments every INCREMENT_RESOLUTION us
 #define DEFAULT_PPS 500								// default pulses per second - speed
 
+//motion engine config (multi-axis, non-blocking)
+#define STEPPER_MAX_AXES			3				// max number of axes driven by the motion engine
+#define STEPPER_QUEUE_SIZE		8				// number of segments in motion queue. Must be power of 2.
+#define STEPPER_TICK_FREQ			10000		// motion engine interrupt frequency [Hz] = max step rate of any axis
+#define STEPPER_START_PPS			100			// motion engine: speed at which motor can start/stop without ramp
+#define STEPPER_DEFAULT_JERK	100			// motion engine: max instant speed change of any axis at junction [pps]
 		
 typedef enum
 {
@@ -52,32 +94,125 @@ typedef struct
 	uint32_t motor_pin_3;
 	GPIO_TypeDef* motor_pin_4_bank;	// pin4
 	uint32_t motor_pin_4;				
-	uint8_t use_half_step;			// 1 when the StepperEx motor is to be driven with half steps (only 4-wire)
+	uint8_t use_half_step;			// USE_FULL_STEP, USE_HALF_STEP or USE_WAVE_STEP (only 4-wire)
 	uint8_t maintain_position;	// MAINTAIN_POS to hold position after last step
+	
+	// microstepping (stepperInit_microstep): motor pins 1-4 must be channels 1-4 of pwm_timer
+	// STEP/DIR (stepperInit_stepdir): motor pin 1 = STEP (pwm_timer channel 1), motor pin 2 = DIR
+	TIM_TypeDef* pwm_timer;			// microstepping: TIM1 or TIM3, STEP/DIR: TIM15 or TIM17
+	uint8_t pwm_af;							// GPIO_AF_x of motor pins for pwm_timer channels
+	uint8_t microsteps;					// 4, 8, 16 or 32 microsteps per full step
 
 	// user can also set/read these values
 	int32_t steps_per_revolution;	// steps in one output shaft rotation
 	uint32_t correction_pulses;		// number of correction pulses - number of steps before output shaft actually moves
-	int32_t target_step_number;		// target step number
+	volatile int32_t target_step_number;		// target step number, can be changed in interrupt routine
 	int32_t current_step_number;	// current number of steps from home position. +/-
 	uint32_t stepper_speed;   		// speed in pulses per second
+	uint32_t max_speed;						// motion engine: max speed of this axis in pulses per second. 0 = no limit
+	
+	// limit/home switch and soft limits (optional): set after init, then call stepperLimitInit()
+	GPIO_TypeDef* limit_switch_bank;	// 0 = no limit switch
+	uint32_t limit_switch_pin;
+	uint8_t limit_switch_active;			// Bit_RESET: pressed switch pulls pin low, Bit_SET: pulls pin high
+	direction_t home_direction;				// direction of movement towards limit switch
+	int32_t soft_limit_min;						// moves are limited to soft_limit_min - soft_limit_max, if soft_limit_min < soft_limit_max
+	int32_t soft_limit_max;
+	uint32_t lost_steps;							// sum of differences between expected and actual switch position (stepperHome)
 	
 	// stepper motor "private variables" - asigned in stepperInit_ function. Can be readed if needed. 
 	uint8_t number_of_steps;  // total number of steps this motor can take
 	uint8_t pin_count;        // whether you're driving the motor with 2 or 4 pins
 	uint8_t step_number;      // which step the motor is on
+	uint8_t drive_mode;				// STEPPER_DRIVE_GPIO or STEPPER_DRIVE_PWM
+	uint8_t microstep_shift;	// sine table index = step_number << microstep_shift
+	uint32_t speed_pps;				// speed in pulses per second (setSpeed)
+	volatile uint8_t limit_hit;	// limit switch pressed during move (or before move towards it) - move stopped
+	uint8_t homed;						// 1 after successful stepperHome()
+	
+	// user units (stepperSetUnits): conversion factors precalculated at init, value = (x * factor) >> shift
+	uint32_t unit_to_step_factor;
+	uint32_t step_to_unit_factor;
+	uint8_t unit_to_step_shift;
+	uint8_t step_to_unit_shift;
+	int32_t unit_position;			// Q16.16 position of last moveToUnits()/moveByUnits() - relative moves don't drift
+	int32_t unit_position_steps;	// unit_position in steps. If target_step_number changes, unit_position is recalculated
+	
+	// coil power management (stepperPowerInit): settle, hold and timeout handled in TIM14 interrupt
+	uint8_t power_managed;				// 0: coils released after move (maintain_position)
+	volatile uint8_t power_state;	// STEPPER_POWER_OFF, _MOVING, _SETTLE, _HOLD
+	volatile uint32_t power_countdown;	// ticks left in current power_state
+	uint32_t hold_settle_ticks;		// full current time after move [STEPPER_POWER_TICK_FREQ ticks]
+	uint32_t hold_timeout_ticks;	// holding current time, 0 = hold until next move
+	uint8_t hold_chop;						// GPIO: coils on for hold_chop of STEPPER_CHOP_STEPS ticks
+	uint16_t hold_scale;					// PWM: holding current amplitude, 256 = full
+	uint16_t microstep_scale;			// PWM: current amplitude of _stepper_microstep(), 256 = full
+	
+	// STEP/DIR: acceleration ramp (precalculated in setSpeed/setAcceleration) and pulse generator state
+	uint32_t acceleration;		// [pulses/s^2], 0 = no ramp
+	uint16_t ramp_period[STEPPER_RAMP_SIZE];	// STEP period of each ramp speed level [timer ticks]
+	uint8_t ramp_rcr[STEPPER_RAMP_SIZE];			// number of pulses of each ramp speed level - 1
+	uint8_t ramp_blocks;			// number of ramp speed levels (0 = no ramp)
+	uint16_t cruise_period;		// STEP period at speed_pps [timer ticks]
+	volatile uint8_t stepdir_moving;	// 1 while pulses are generated
+	uint8_t stepdir_phase;		// accelerate, cruise, decelerate
+	uint8_t stepdir_index;		// ramp speed level
+	uint8_t stepdir_accel_blocks;	// number of ramp speed levels of this move
+	uint16_t stepdir_peak_period;	// cruise period of this move
+	uint32_t stepdir_cruise_left;	// cruise pulses left
+	uint16_t stepdir_block_pulses[2];	// pulses of block being generated and of next (preloaded) block
+	uint32_t stepdir_block_ms;			// start of block being generated: millis()
+	uint32_t stepdir_block_systick;	// and SysTick->VAL (pulses generated before limit switch stop)
 	direction_t direction;		// Direction of rotation
+	GPIO_TypeDef* phase_port[4];		// GPIO ports of motor pins (each port only once)
+	uint8_t phase_port_count;				// number of different GPIO ports used
+	uint32_t phase_bsrr[8][4];			// BSRR value for each step and port: all pins of a port switched with single write
+	uint32_t release_bsrr[4];				// BSRR value for each port: reset all motor pins
 	
 }stepper_struct;
 
+typedef struct
+{
+	// used by interrupt routine. Rates are for the axis with most steps [pulses per second * 256]
+	uint32_t steps[STEPPER_MAX_AXES];	// number of steps of each axis (absolute value)
+	uint8_t direction_bits;						// bit n set: axis n moves CW
+	uint32_t step_event_count;				// number of steps of the axis with most steps
+	uint32_t nominal_rate;						// cruise rate
+	uint32_t initial_rate;						// rate at segment start
+	uint32_t final_rate;							// rate at segment end
+	uint32_t rate_delta;							// rate change on every engine tick while accelerating/decelerating
+	uint32_t accelerate_until;				// accelerate until this step event
+	uint32_t decelerate_after;				// decelerate after this step event
+	uint32_t hold_ticks;							// MAINTAIN_POS hold time after last step [engine ticks]
+	
+	// used by look-ahead planner [pulses per second]
+	float nominal_speed;							// requested speed
+	float max_entry_speed;						// max junction speed with previous segment
+	float entry_speed;								// planned entry speed
+}stepper_segment_t;
+
 // set stepper: GPIO pins, USE_HALF_STEP, DONT_MAINTAIN_POS
 void stepperInit_2pin(stepper_struct* current_stepper);
 void stepperInit_4pin(stepper_struct* current_stepper);
+// set stepper: GPIO pins, pwm_timer, pwm_af, microsteps, DONT_MAINTAIN_POS
+void stepperInit_microstep(stepper_struct* current_stepper);
+// set stepper: STEP and DIR pin, pwm_timer, pwm_af
+void stepperInit_stepdir(stepper_struct* current_stepper);
 
 void setSpeed(stepper_struct* current_stepper, uint32_t pulsesPerSecond);	// set speed- pulsesPerSecond: 1<
+void setAcceleration(stepper_struct* current_stepper, uint32_t pulsesPerSecond2);	// STEP/DIR: acceleration ramp, 0 = no ramp
 void setHomePos(stepper_struct* current_stepper);			// set current position as home - reference position
 void moveToHomePos(stepper_struct* current_stepper);		// move to home position
 
+// limit switch: configure limit_switch_ pin as EXTI input. Call stepperLimitCallback() from EXTIx_IRQHandler.
+void stepperLimitInit(stepper_struct* current_stepper);
+
+// limit switch interrupt: stop move of stepper with limit switch on EXTI_Line (EXTI_Line0 - EXTI_Line15) 
+void stepperLimitCallback(uint32_t EXTI_Line);
+
+// blocking homing: seek switch with seek_speed, back off, approach again with locate_speed. Returns 0 if switch not found.
+uint8_t stepperHome(stepper_struct* current_stepper, uint32_t seek_speed, uint32_t locate_speed, uint32_t backoff_steps, uint32_t max_travel);
+
 // blocking move function.
 void step(stepper_struct* current_stepper, int steps_to_move);
 
@@ -87,15 +222,72 @@ void moveToTargetPos(stepper_struct* current_stepper);
 // blocking move function. Allow change of target position during rotation, move optimally
 void moveToTargetPosOptimally(stepper_struct* current_stepper);
 
-// convert angle to pulses - relative to stepper motor steps_per_revolution
+// STEP/DIR: start move to target_step_number and return immediately. Pulses are generated by pwm_timer.
+void startMoveToTargetPos(stepper_struct* current_stepper);
+
+// STEP/DIR: returns 1 while motor is moving
+uint8_t isMoving(stepper_struct* current_stepper);
+
+// coil power management: full current for settle_ms after move, then hold_current % (0-100) until idle_timeout_ms 
+// (0 = hold until next move), then coils are released. Non-blocking, TIM14 is used. Replaces maintain_position.
+void stepperPowerInit(stepper_struct* current_stepper, uint16_t settle_ms, uint8_t hold_current, uint32_t idle_timeout_ms);
+
+// convert angle to pulses - relative to stepper motor steps_per_revolution. Kept for compatibility, use unitsToSteps()
 int32_t angleToPulses(stepper_struct* current_stepper, int32_t angle);
 
+/* USER UNITS: Q16.16 fixed point values, no divisions after stepperSetUnits() */
+// set user unit: "steps" steps are "units" user units. Default (init): steps_per_revolution steps = 360 degrees
+void stepperSetUnits(stepper_struct* current_stepper, uint32_t steps, uint32_t units);
+
+// convert Q16.16 user units to steps (rounded) and back
+int32_t unitsToSteps(stepper_struct* current_stepper, int32_t units);
+int32_t stepsToUnits(stepper_struct* current_stepper, int32_t steps);
+
+// speed in user units per second, acceleration in user units per second^2 (Q16.16)
+void setSpeedUnits(stepper_struct* current_stepper, uint32_t units_per_second);
+void setAccelerationUnits(stepper_struct* current_stepper, uint32_t units_per_second2);
+
+// blocking move to absolute position / by relative distance in user units (Q16.16)
+void moveToUnits(stepper_struct* current_stepper, int32_t position);
+void moveByUnits(stepper_struct* current_stepper, int32_t distance);
+
+// current position in user units (Q16.16)
+int32_t getPositionUnits(stepper_struct* current_stepper);
+
+/* MOTION ENGINE: N axes moved simultaneously from TIM16 interrupt. Non-blocking. */
+// set axes (already initialized with stepperInit_) and take over TIM16. Don't use blocking move functions after this.
+void stepperEngineInit(stepper_struct** axes, uint8_t axis_count);
+
+// set acceleration [pulses/s^2] of the axis with most steps (0 = no ramps) and max junction speed change [pps]
+void stepperSetAcceleration(uint32_t acceleration, uint32_t jerk);
+
+// queue relative move of all axes. Axes start and finish together. Returns 0 if queue is full.
+uint8_t stepperQueueMove(const int32_t* steps, uint32_t pulsesPerSecond);
+
+// queue move of all axes to their target_step_number. Returns 0 if queue is full.
+uint8_t stepperQueueTargetPos(uint32_t pulsesPerSecond);
+
+// returns 1 while motion queue is not empty or any axis is still moving
+uint8_t stepperEngineBusy(void);
+
+// wait until all queued moves are finished
+void stepperEngineWait(void);
+
+// stop immediately, discard all queued moves and reset motor pins
+void stepperEngineStop(void);
+
 /* "private function" */
 // step motor
 void stepMotor(stepper_struct* current_stepper, int this_step);
 
 // set timer 16 for delay and interrupt setup.
 void timer16_init( void );		
+
+// set timer 16 as motion engine time base: interrupt every 1/STEPPER_TICK_FREQ s.
+void timer16_engine_init( void );
+
+// system clock changed: recalculate TIM16, TIM14 and STEP/DIR timer prescalers (register with clock_register())
+void stepperClockUpdate(const RCC_ClocksTypeDef* clocks);
 		
 #ifdef __cplusplus
 }
@@ -0,0 +1,339 @@
+/*
+ ===============================================================================
+            ##### Host test stub: STM32F0 registers and StdPeriph #####
+																	h file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Only what stepper, gpio_init, reg and atomic drivers use. Peripherals are plain
+ * structs in RAM (spl_stub.c), interrupts are called by test code.
+ */
+#ifndef __STM32F0XX_H
+#define __STM32F0XX_H
+
+#include <stdint.h>
+
+#define __IO volatile
+#define __I volatile const
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+
+typedef enum {
+	EXTI0_1_IRQn = 5,
+	EXTI2_3_IRQn = 6,
+	EXTI4_15_IRQn = 7,
+	TIM1_CC_IRQn = 14,
+	TIM3_IRQn = 16,
+	TIM14_IRQn = 19,
+	TIM15_IRQn = 20,
+	TIM16_IRQn = 21,
+	TIM17_IRQn = 22
+} IRQn_Type;
+
+/* Registers -----------------------------------------------------------------*/
+typedef struct {
+	__IO uint32_t MODER;
+	__IO uint16_t OTYPER, RESERVED0;
+	__IO uint32_t OSPEEDR;
+	__IO uint32_t PUPDR;
+	__IO uint16_t IDR, RESERVED1;
+	__IO uint16_t ODR, RESERVED2;
+	__IO uint32_t BSRR;
+	__IO uint32_t LCKR;
+	__IO uint32_t AFR[2];
+	__IO uint16_t BRR, RESERVED3;
+} GPIO_TypeDef;
+
+typedef struct {
+	__IO uint16_t CR1, RESERVED0, CR2, RESERVED1, SMCR, RESERVED2, DIER, RESERVED3, SR, RESERVED4, EGR, RESERVED5;
+	__IO uint16_t CCMR1, RESERVED6, CCMR2, RESERVED7, CCER, RESERVED8;
+	__IO uint32_t CNT;
+	__IO uint16_t PSC, RESERVED9;
+	__IO uint32_t ARR;
+	__IO uint16_t RCR, RESERVED10;
+	__IO uint32_t CCR1, CCR2, CCR3, CCR4;
+	__IO uint16_t BDTR, RESERVED11, DCR, RESERVED12, DMAR, RESERVED13, OR, RESERVED14;
+} TIM_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1, CR2, CR3;
+	__IO uint16_t BRR, RESERVED0, GTPR, RESERVED1;
+	__IO uint32_t RTOR;
+	__IO uint16_t RQR, RESERVED2;
+	__IO uint32_t ISR, ICR;
+	__IO uint16_t RDR, RESERVED3, TDR, RESERVED4;
+} USART_TypeDef;
+
+typedef struct {
+	__IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct {
+	__IO uint32_t ISR, IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+	__IO uint32_t CTRL, LOAD, VAL;
+	__I uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+	__I uint32_t CPUID;
+	__IO uint32_t ICSR;
+	uint32_t RESERVED0;
+	__IO uint32_t AIRCR, SCR, CCR;
+	uint32_t RESERVED1;
+	__IO uint32_t SHP[2], SHCSR;
+} SCB_Type;
+
+extern GPIO_TypeDef *GPIOA, *GPIOB, *GPIOC, *GPIOD, *GPIOE, *GPIOF;
+extern TIM_TypeDef *TIM1, *TIM2, *TIM3, *TIM14, *TIM15, *TIM16, *TIM17;
+extern USART_TypeDef *USART1, *USART2;
+extern EXTI_TypeDef *EXTI;
+extern DMA_TypeDef *DMA1;
+extern SysTick_Type *SysTick;
+extern SCB_Type *SCB;
+
+#define TIM_CR1_CEN							0x0001
+#define TIM_SR_UIF							0x0001
+#define TIM_DIER_UIE						0x0001
+#define TIM_EGR_UG							0x0001
+#define USART_ISR_RXNE					0x0020
+#define USART_ISR_TXE						0x0080
+#define SysTick_CTRL_ENABLE_Msk	0x00000001
+#define SCB_ICSR_PENDSTSET_Msk	0x04000000
+
+/* CMSIS core: single threaded host, interrupts are always "enabled" -------*/
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline void __DMB(void) {}
+static inline void __DSB(void) {}
+static inline void __NOP(void) {}
+#define __nop()		__NOP()
+uint32_t SysTick_Config(uint32_t ticks);
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+
+extern uint32_t SystemCoreClock;
+
+/* GPIO ----------------------------------------------------------------------*/
+typedef enum {GPIO_Mode_IN = 0, GPIO_Mode_OUT = 1, GPIO_Mode_AF = 2, GPIO_Mode_AN = 3} GPIOMode_TypeDef;
+typedef enum {GPIO_OType_PP = 0, GPIO_OType_OD = 1} GPIOOType_TypeDef;
+typedef enum {GPIO_Speed_Level_1 = 1, GPIO_Speed_Level_2 = 2, GPIO_Speed_Level_3 = 3} GPIOSpeed_TypeDef;
+typedef enum {GPIO_PuPd_NOPULL = 0, GPIO_PuPd_UP = 1, GPIO_PuPd_DOWN = 2} GPIOPuPd_TypeDef;
+typedef enum {Bit_RESET = 0, Bit_SET} BitAction;
+
+typedef struct {
+	uint32_t GPIO_Pin;
+	GPIOMode_TypeDef GPIO_Mode;
+	GPIOSpeed_TypeDef GPIO_Speed;
+	GPIOOType_TypeDef GPIO_OType;
+	GPIOPuPd_TypeDef GPIO_PuPd;
+} GPIO_InitTypeDef;
+
+#define GPIO_Speed_2MHz					GPIO_Speed_Level_1
+#define GPIO_Speed_10MHz				GPIO_Speed_Level_2
+#define GPIO_Speed_50MHz				GPIO_Speed_Level_3
+
+#define GPIO_Pin_0							0x0001
+#define GPIO_Pin_1							0x0002
+#define GPIO_Pin_2							0x0004
+#define GPIO_Pin_3							0x0008
+#define GPIO_Pin_4							0x0010
+#define GPIO_Pin_5							0x0020
+#define GPIO_Pin_6							0x0040
+#define GPIO_Pin_7							0x0080
+#define GPIO_Pin_8							0x0100
+#define GPIO_Pin_9							0x0200
+#define GPIO_Pin_10							0x0400
+#define GPIO_Pin_11							0x0800
+#define GPIO_Pin_12							0x1000
+#define GPIO_Pin_13							0x2000
+#define GPIO_Pin_14							0x4000
+#define GPIO_Pin_15							0x8000
+#define GPIO_Pin_All						0xFFFF
+
+#define GPIO_PinSource0					0
+#define GPIO_PinSource1					1
+#define GPIO_PinSource2					2
+#define GPIO_PinSource3					3
+#define GPIO_PinSource4					4
+#define GPIO_PinSource5					5
+#define GPIO_PinSource6					6
+#define GPIO_PinSource7					7
+#define GPIO_PinSource8					8
+#define GPIO_PinSource9					9
+#define GPIO_PinSource10				10
+#define GPIO_PinSource11				11
+#define GPIO_PinSource12				12
+#define GPIO_PinSource13				13
+#define GPIO_PinSource14				14
+#define GPIO_PinSource15				15
+
+#define GPIO_AF_0								0
+#define GPIO_AF_1								1
+#define GPIO_AF_2								2
+#define GPIO_AF_3								3
+#define GPIO_AF_4								4
+#define GPIO_AF_5								5
+#define GPIO_AF_6								6
+#define GPIO_AF_7								7
+
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct);
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF);
+void GPIO_SetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void GPIO_ResetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+
+/* RCC -----------------------------------------------------------------------*/
+typedef struct {
+	uint32_t SYSCLK_Frequency;
+	uint32_t HCLK_Frequency;
+	uint32_t PCLK_Frequency;
+	uint32_t ADCCLK_Frequency;
+	uint32_t CECCLK_Frequency;
+	uint32_t I2C1CLK_Frequency;
+	uint32_t USART1CLK_Frequency;
+	uint32_t USART2CLK_Frequency;
+	uint32_t USART3CLK_Frequency;
+	uint32_t USBCLK_Frequency;
+} RCC_ClocksTypeDef;
+
+#define RCC_AHBPeriph_GPIOA			0x00020000
+#define RCC_AHBPeriph_GPIOB			0x00040000
+#define RCC_AHBPeriph_GPIOC			0x00080000
+#define RCC_AHBPeriph_GPIOD			0x00100000
+#define RCC_AHBPeriph_GPIOE			0x00200000
+#define RCC_AHBPeriph_GPIOF			0x00400000
+#define RCC_APB2Periph_SYSCFG		0x00000001
+#define RCC_APB2Periph_TIM1			0x00000800
+#define RCC_APB2Periph_TIM15		0x00010000
+#define RCC_APB2Periph_TIM16		0x00020000
+#define RCC_APB2Periph_TIM17		0x00040000
+#define RCC_APB1Periph_TIM3			0x00000002
+#define RCC_APB1Periph_TIM14		0x00000100
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef* RCC_Clocks);
+void RCC_AHBPeriphClockCmd(uint32_t RCC_AHBPeriph, FunctionalState NewState);
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState);
+void RCC_APB2PeriphClockCmd(uint32_t RCC_APB2Periph, FunctionalState NewState);
+
+/* TIM -----------------------------------------------------------------------*/
+typedef struct {
+	uint16_t TIM_Prescaler;
+	uint16_t TIM_CounterMode;
+	uint32_t TIM_Period;
+	uint16_t TIM_ClockDivision;
+	uint8_t TIM_RepetitionCounter;
+} TIM_TimeBaseInitTypeDef;
+
+typedef struct {
+	uint16_t TIM_OCMode;
+	uint16_t TIM_OutputState;
+	uint16_t TIM_OutputNState;
+	uint32_t TIM_Pulse;
+	uint16_t TIM_OCPolarity;
+	uint16_t TIM_OCNPolarity;
+	uint16_t TIM_OCIdleState;
+	uint16_t TIM_OCNIdleState;
+} TIM_OCInitTypeDef;
+
+#define TIM_CounterMode_Up			0x0000
+#define TIM_CKD_DIV1						0x0000
+#define TIM_IT_Update						0x0001
+#define TIM_OCMode_PWM1					0x0060
+#define TIM_OutputState_Enable	0x0001
+#define TIM_OCPolarity_High			0x0000
+#define TIM_OCPreload_Enable		0x0008
+#define TIM_EventSource_Update	0x0001
+#define TIM_PSCReloadMode_Update		0x0000
+#define TIM_UpdateSource_Regular		0x0001
+
+void TIM_TimeBaseInit(TIM_TypeDef* TIMx, TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct);
+void TIM_OCStructInit(TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC1Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC2Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC3Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC4Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC1PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_OC2PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_OC3PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_OC4PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_ARRPreloadConfig(TIM_TypeDef* TIMx, FunctionalState NewState);
+void TIM_CtrlPWMOutputs(TIM_TypeDef* TIMx, FunctionalState NewState);
+void TIM_SetAutoreload(TIM_TypeDef* TIMx, uint32_t Autoreload);
+void TIM_PrescalerConfig(TIM_TypeDef* TIMx, uint16_t Prescaler, uint16_t TIM_PSCReloadMode);
+void TIM_UpdateRequestConfig(TIM_TypeDef* TIMx, uint16_t TIM_UpdateSource);
+void TIM_GenerateEvent(TIM_TypeDef* TIMx, uint16_t TIM_EventSource);
+void TIM_ITConfig(TIM_TypeDef* TIMx, uint16_t TIM_IT, FunctionalState NewState);
+ITStatus TIM_GetITStatus(TIM_TypeDef* TIMx, uint16_t TIM_IT);
+void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT);
+void TIM_Cmd(TIM_TypeDef* TIMx, FunctionalState NewState);
+
+/* NVIC ----------------------------------------------------------------------*/
+typedef struct {
+	uint8_t NVIC_IRQChannel;
+	uint8_t NVIC_IRQChannelPriority;
+	FunctionalState NVIC_IRQChannelCmd;
+} NVIC_InitTypeDef;
+
+void NVIC_Init(NVIC_InitTypeDef* NVIC_InitStruct);
+
+/* EXTI, SYSCFG --------------------------------------------------------------*/
+typedef enum {EXTI_Mode_Interrupt = 0x00, EXTI_Mode_Event = 0x04} EXTIMode_TypeDef;
+typedef enum {EXTI_Trigger_Rising = 0x08, EXTI_Trigger_Falling = 0x0C, EXTI_Trigger_Rising_Falling = 0x10} EXTITrigger_TypeDef;
+
+typedef struct {
+	uint32_t EXTI_Line;
+	EXTIMode_TypeDef EXTI_Mode;
+	EXTITrigger_TypeDef EXTI_Trigger;
+	FunctionalState EXTI_LineCmd;
+} EXTI_InitTypeDef;
+
+#define EXTI_Line0							0x00000001
+#define EXTI_Line1							0x00000002
+#define EXTI_Line2							0x00000004
+#define EXTI_Line3							0x00000008
+#define EXTI_Line4							0x00000010
+#define EXTI_Line5							0x00000020
+#define EXTI_Line6							0x00000040
+#define EXTI_Line7							0x00000080
+#define EXTI_Line8							0x00000100
+#define EXTI_Line9							0x00000200
+#define EXTI_Line10							0x00000400
+#define EXTI_Line11							0x00000800
+#define EXTI_Line12							0x00001000
+#define EXTI_Line13							0x00002000
+#define EXTI_Line14							0x00004000
+#define EXTI_Line15							0x00008000
+
+#define EXTI_PortSourceGPIOA		0x00
+#define EXTI_PortSourceGPIOB		0x01
+#define EXTI_PortSourceGPIOC		0x02
+#define EXTI_PinSource0					0x00
+#define EXTI_PinSource1					0x01
+#define EXTI_PinSource2					0x02
+#define EXTI_PinSource3					0x03
+#define EXTI_PinSource4					0x04
+#define EXTI_PinSource5					0x05
+#define EXTI_PinSource6					0x06
+#define EXTI_PinSource7					0x07
+#define EXTI_PinSource8					0x08
+#define EXTI_PinSource9					0x09
+#define EXTI_PinSource10				0x0A
+#define EXTI_PinSource11				0x0B
+#define EXTI_PinSource12				0x0C
+#define EXTI_PinSource13				0x0D
+#define EXTI_PinSource14				0x0E
+#define EXTI_PinSource15				0x0F
+
+void EXTI_Init(EXTI_InitTypeDef* EXTI_InitStruct);
+void SYSCFG_EXTILineConfig(uint8_t EXTI_PortSourceGPIOx, uint8_t EXTI_PinSourcex);
+
+#endif
@@ -0,0 +1,2 @@
+/* Host test stub: all StdPeriph declarations used by the stepper driver are in stm32f0xx.h */
+#include "stm32f0xx.h"
@@ -0,0 +1,106 @@
+/*
+ ===============================================================================
+            ##### Host test stub: STM32F0 registers and StdPeriph #####
+																	c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Peripherals are plain structs, StdPeriph calls only write registers that drivers read back.
+ */
+
+#include "stm32f0xx.h"
+
+static GPIO_TypeDef gpio[6];
+static TIM_TypeDef tim[7];
+static USART_TypeDef usart[2];
+static EXTI_TypeDef exti;
+static DMA_TypeDef dma;
+static SysTick_Type systick = {0, 47999, 0, 0};
+static SCB_Type scb;
+
+GPIO_TypeDef *GPIOA = &gpio[0], *GPIOB = &gpio[1], *GPIOC = &gpio[2], *GPIOD = &gpio[3], *GPIOE = &gpio[4], *GPIOF = &gpio[5];
+TIM_TypeDef *TIM1 = &tim[0], *TIM2 = &tim[1], *TIM3 = &tim[2], *TIM14 = &tim[3], *TIM15 = &tim[4], *TIM16 = &tim[5], *TIM17 = &tim[6];
+USART_TypeDef *USART1 = &usart[0], *USART2 = &usart[1];
+EXTI_TypeDef *EXTI = &exti;
+DMA_TypeDef *DMA1 = &dma;
+SysTick_Type *SysTick = &systick;
+SCB_Type *SCB = &scb;
+
+uint32_t SystemCoreClock = 48000000;
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) { (void)IRQn; }
+void NVIC_DisableIRQ(IRQn_Type IRQn) { (void)IRQn; }
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) { (void)IRQn; (void)priority; }
+void NVIC_Init(NVIC_InitTypeDef* NVIC_InitStruct) { (void)NVIC_InitStruct; }
+
+// SysTick is not simulated: stays disabled, millis() doesn't change
+uint32_t SysTick_Config(uint32_t ticks) { SysTick->LOAD = ticks - 1; return 0; }
+
+/* GPIO: BSRR/BRR writes of reg_gpio* functions are not applied to ODR, tests check step counters */
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct) { (void)GPIOx; (void)GPIO_InitStruct; }
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF) { (void)GPIOx; (void)GPIO_PinSource; (void)GPIO_AF; }
+void GPIO_SetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) { GPIOx->ODR |= GPIO_Pin; }
+void GPIO_ResetBits(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) { GPIOx->ODR &= ~GPIO_Pin; }
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) { return (GPIOx->IDR & GPIO_Pin) ? 1 : 0; }
+
+/* RCC */
+void RCC_GetClocksFreq(RCC_ClocksTypeDef* RCC_Clocks)
+{
+	RCC_Clocks->SYSCLK_Frequency = SystemCoreClock;
+	RCC_Clocks->HCLK_Frequency = SystemCoreClock;
+	RCC_Clocks->PCLK_Frequency = SystemCoreClock;
+}
+void RCC_AHBPeriphClockCmd(uint32_t RCC_AHBPeriph, FunctionalState NewState) { (void)RCC_AHBPeriph; (void)NewState; }
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState) { (void)RCC_APB1Periph; (void)NewState; }
+void RCC_APB2PeriphClockCmd(uint32_t RCC_APB2Periph, FunctionalState NewState) { (void)RCC_APB2Periph; (void)NewState; }
+
+/* TIM */
+void TIM_TimeBaseInit(TIM_TypeDef* TIMx, TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct)
+{
+	TIMx->PSC = TIM_TimeBaseInitStruct->TIM_Prescaler;
+	TIMx->ARR = TIM_TimeBaseInitStruct->TIM_Period;
+	TIMx->RCR = TIM_TimeBaseInitStruct->TIM_RepetitionCounter;
+}
+void TIM_OCStructInit(TIM_OCInitTypeDef* TIM_OCInitStruct) { (void)TIM_OCInitStruct; }
+void TIM_OC1Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { TIMx->CCR1 = TIM_OCInitStruct->TIM_Pulse; }
+void TIM_OC2Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { TIMx->CCR2 = TIM_OCInitStruct->TIM_Pulse; }
+void TIM_OC3Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { TIMx->CCR3 = TIM_OCInitStruct->TIM_Pulse; }
+void TIM_OC4Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { TIMx->CCR4 = TIM_OCInitStruct->TIM_Pulse; }
+void TIM_OC1PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { (void)TIMx; (void)TIM_OCPreload; }
+void TIM_OC2PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { (void)TIMx; (void)TIM_OCPreload; }
+void TIM_OC3PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { (void)TIMx; (void)TIM_OCPreload; }
+void TIM_OC4PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { (void)TIMx; (void)TIM_OCPreload; }
+void TIM_ARRPreloadConfig(TIM_TypeDef* TIMx, FunctionalState NewState) { (void)TIMx; (void)NewState; }
+void TIM_CtrlPWMOutputs(TIM_TypeDef* TIMx, FunctionalState NewState) { (void)TIMx; (void)NewState; }
+void TIM_SetAutoreload(TIM_TypeDef* TIMx, uint32_t Autoreload) { TIMx->ARR = Autoreload; }
+void TIM_PrescalerConfig(TIM_TypeDef* TIMx, uint16_t Prescaler, uint16_t TIM_PSCReloadMode) { (void)TIM_PSCReloadMode; TIMx->PSC = Prescaler; }
+void TIM_UpdateRequestConfig(TIM_TypeDef* TIMx, uint16_t TIM_UpdateSource) { (void)TIMx; (void)TIM_UpdateSource; }
+void TIM_GenerateEvent(TIM_TypeDef* TIMx, uint16_t TIM_EventSource) { (void)TIMx; (void)TIM_EventSource; }
+void TIM_ITConfig(TIM_TypeDef* TIMx, uint16_t TIM_IT, FunctionalState NewState)
+{
+	if(NewState != DISABLE){
+		TIMx->DIER |= TIM_IT;
+	}
+	else{
+		TIMx->DIER &= ~TIM_IT;
+	}
+}
+ITStatus TIM_GetITStatus(TIM_TypeDef* TIMx, uint16_t TIM_IT)
+{
+	return ((TIMx->SR & TIM_IT) && (TIMx->DIER & TIM_IT)) ? SET : RESET;
+}
+void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT) { TIMx->SR = (uint16_t)~TIM_IT; }
+void TIM_Cmd(TIM_TypeDef* TIMx, FunctionalState NewState)
+{
+	if(NewState != DISABLE){
+		TIMx->CR1 |= TIM_CR1_CEN;
+	}
+	else{
+		TIMx->CR1 &= ~TIM_CR1_CEN;
+	}
+}
+
+/* EXTI, SYSCFG */
+void EXTI_Init(EXTI_InitTypeDef* EXTI_InitStruct) { EXTI->IMR |= EXTI_InitStruct->EXTI_Line; }
+void SYSCFG_EXTILineConfig(uint8_t EXTI_PortSourceGPIOx, uint8_t EXTI_PinSourcex) { (void)EXTI_PortSourceGPIOx; (void)EXTI_PinSourcex; }
@@ -0,0 +1,229 @@
+/*
+ ===============================================================================
+            ##### Host simulation test: motion engine step timing #####
+																	c file
+ ===============================================================================
+ * @date    19-Oct-2026
+ * @author  Domen Jurkovic
+ *
+ * Runs stepper driver on PC: TIM16 update interrupt is called in a loop (one call = one engine tick) and
+ * tick of every step of X axis is recorded. Step speed = STEPPER_TICK_FREQ / ticks since previous step.
+ * Build and run: make (in this folder)
+ */
+
+#include <stdio.h>
+#include "stm32f0xx_stepper.h"
+
+#define MAX_STEPS		10000
+#define MAX_TICKS		1000000
+
+void TIM16_IRQHandler(void);
+
+static stepper_struct axis_x, axis_y;
+static uint32_t step_tick[MAX_STEPS];
+static int32_t step_position[MAX_STEPS];
+static uint32_t step_count;
+static uint32_t failed;
+
+#define CHECK(condition, ...)	do{ \
+		if(!(condition)){ printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failed++; } \
+	} while(0)
+
+static void axis_init(stepper_struct* axis, GPIO_TypeDef* bank)
+{
+	axis->motor_pin_1_bank = bank;
+	axis->motor_pin_2_bank = bank;
+	axis->motor_pin_3_bank = bank;
+	axis->motor_pin_4_bank = bank;
+	axis->motor_pin_1 = GPIO_Pin_0;
+	axis->motor_pin_2 = GPIO_Pin_1;
+	axis->motor_pin_3 = GPIO_Pin_2;
+	axis->motor_pin_4 = GPIO_Pin_3;
+	stepperInit_4pin(axis);
+}
+
+// empty queue, set both axes to position 0 and set engine acceleration
+static void engine_reset(uint32_t acceleration, uint32_t jerk)
+{
+	axis_x.current_step_number = 0;
+	axis_y.current_step_number = 0;
+	stepperEngineStop();
+	stepperSetAcceleration(acceleration, jerk);
+}
+
+// run engine for max ticks or until queue is empty, record ticks and positions of X axis steps
+static void engine_run_ticks(uint32_t ticks)
+{
+	uint32_t tick = 0;
+	int32_t position = axis_x.current_step_number;
+
+	step_count = 0;
+	while(stepperEngineBusy() && (tick < ticks)){
+		if(TIM16->CR1 & TIM_CR1_CEN){
+			TIM16->SR |= TIM_SR_UIF;
+			TIM16_IRQHandler();
+		}
+		tick++;
+		if((axis_x.current_step_number != position) && (step_count < MAX_STEPS)){
+			position = axis_x.current_step_number;
+			step_tick[step_count] = tick;
+			step_position[step_count] = position;
+			step_count++;
+		}
+	}
+}
+
+// run engine until queue is empty
+static void engine_run(void)
+{
+	engine_run_ticks(MAX_TICKS);
+	CHECK(stepperEngineBusy() == 0, "engine still busy after %d ticks", MAX_TICKS);
+}
+
+// average speed [steps/s] of step (index from 1) since previous step
+static float step_speed(uint32_t step)
+{
+	return (float)STEPPER_TICK_FREQ / (step_tick[step] - step_tick[step - 1]);
+}
+
+// lowest step speed in steps first..last
+static float min_speed(uint32_t first, uint32_t last)
+{
+	float speed = step_speed(first);
+
+	for(; first <= last; first++){
+		if(step_speed(first) < speed){
+			speed = step_speed(first);
+		}
+	}
+	return speed;
+}
+
+// collinear segments: engine must not slow down at the junction
+static void test_blend_through(void)
+{
+	int32_t move_1[] = {2000, 0};
+	int32_t move_2[] = {2000, 10};	// direction change of Y axis is below jerk limit
+	float speed;
+
+	engine_reset(4000, 100);
+	stepperQueueMove(move_1, 2000);
+	stepperQueueMove(move_2, 2000);
+	engine_run();
+
+	CHECK(step_count == 4000, "blend through: %u steps, expected 4000", step_count);
+	CHECK(axis_x.current_step_number == 4000, "blend through: X at %d, expected 4000", axis_x.current_step_number);
+	CHECK(axis_y.current_step_number == 10, "blend through: Y at %d, expected 10", axis_y.current_step_number);
+	speed = min_speed(1990, 2010);
+	CHECK(speed >= 0.9f * 2000, "blend through: junction speed %.0f steps/s, expected 2000", speed);
+}
+
+// slower next segment: engine decelerates to its nominal speed, not to stop
+static void test_blend_slower(void)
+{
+	int32_t move[] = {2000, 0};
+	float speed;
+
+	engine_reset(4000, 100);
+	stepperQueueMove(move, 2000);
+	stepperQueueMove(move, 1000);
+	engine_run();
+
+	CHECK(step_count == 4000, "blend slower: %u steps, expected 4000", step_count);
+	speed = min_speed(1995, 2005);
+	CHECK(speed >= 0.9f * 1000, "blend slower: junction speed %.0f steps/s, expected 1000", speed);
+	speed = step_speed(1999);
+	CHECK(speed <= 1.2f * 1000, "blend slower: speed %.0f steps/s at the end of faster segment, expected 1000", speed);
+}
+
+/*
+	Reversal of X axis: speed change at junction is 2 * junction speed, so junction speed is jerk / 2
+	(but not below STEPPER_START_PPS, at which motor can always stop and start).
+	reversal_limit: expected junction speed. Speed of last step before and first step after reversal is checked.
+*/
+static void test_reversal(uint32_t jerk, float reversal_limit)
+{
+	int32_t forward[] = {2000, 0};
+	int32_t backward[] = {-500, 0};
+	float speed_before, speed_after;
+
+	engine_reset(4000, jerk);
+	stepperQueueMove(forward, 2000);
+	stepperQueueMove(backward, 1000);
+	engine_run();
+
+	CHECK(step_count == 2500, "reversal (jerk %u): %u steps, expected 2500", jerk, step_count);
+	CHECK(axis_x.current_step_number == 1500, "reversal (jerk %u): X at %d, expected 1500", jerk, axis_x.current_step_number);
+	CHECK((step_position[1999] == 2000) && (step_position[2000] == 1999), "reversal (jerk %u): direction change not at step 2000", jerk);
+
+	speed_before = step_speed(1999);
+	speed_after = step_speed(2000);
+	CHECK(speed_before <= 1.5f * reversal_limit, "reversal (jerk %u): speed %.0f steps/s before reversal, limit %.0f", jerk, speed_before, reversal_limit);
+	CHECK(speed_after <= 1.5f * reversal_limit, "reversal (jerk %u): speed %.0f steps/s after reversal, limit %.0f", jerk, speed_after, reversal_limit);
+	CHECK(speed_before >= 0.5f * reversal_limit, "reversal (jerk %u): speed %.0f steps/s before reversal, motor should not stop", jerk, speed_before);
+	CHECK(speed_after >= 0.5f * reversal_limit, "reversal (jerk %u): speed %.0f steps/s after reversal, motor should not stop", jerk, speed_after);
+}
+
+// limit switch of X axis (towards CCW) is pressed during move: only move towards the switch is stopped
+static void test_limit_direction(void)
+{
+	int32_t away[] = {1000, 0};
+	const int32_t towards[] = {-1000, 0};	// move table is reused: must not be modified
+	int32_t position;
+
+	engine_reset(4000, 100);
+	GPIOC->IDR |= GPIO_Pin_5;		// released
+	stepperQueueMove(away, 1000);
+	engine_run_ticks(2000);
+	GPIOC->IDR &= ~GPIO_Pin_5;	// pressed
+	stepperLimitCallback(EXTI_Line5);
+	engine_run();
+	CHECK(axis_x.current_step_number == 1000, "limit: move away from switch stopped at %d, expected 1000", axis_x.current_step_number);
+	CHECK(axis_x.limit_hit == 0, "limit: limit_hit set while moving away from switch");
+
+	GPIOC->IDR |= GPIO_Pin_5;
+	stepperQueueMove(towards, 1000);
+	engine_run_ticks(2000);
+	GPIOC->IDR &= ~GPIO_Pin_5;
+	stepperLimitCallback(EXTI_Line5);
+	engine_run();
+	CHECK(axis_x.current_step_number > 0, "limit: move towards switch not stopped, X at %d", axis_x.current_step_number);
+	CHECK(axis_x.limit_hit == 1, "limit: limit_hit not set while moving towards switch");
+	
+	// switch still pressed: move towards it is blocked and reported as hit (stepperHome relies on it)
+	position = axis_x.current_step_number;
+	stepperQueueMove(towards, 1000);
+	engine_run();
+	CHECK(axis_x.current_step_number == position, "limit: blocked move towards pressed switch moved to %d", axis_x.current_step_number);
+	CHECK(axis_x.limit_hit == 1, "limit: limit_hit not set for move blocked by pressed switch");
+	CHECK(towards[0] == -1000, "limit: move table modified by stepperQueueMove (%d)", towards[0]);
+	GPIOC->IDR |= GPIO_Pin_5;
+}
+
+int main(void)
+{
+	stepper_struct* axes[] = {&axis_x, &axis_y};
+
+	axis_init(&axis_x, GPIOA);
+	axis_init(&axis_y, GPIOB);
+	axis_x.limit_switch_bank = GPIOC;
+	axis_x.limit_switch_pin = GPIO_Pin_5;
+	axis_x.limit_switch_active = Bit_RESET;
+	axis_x.home_direction = DIRECTION_CCW;
+	GPIOC->IDR |= GPIO_Pin_5;
+	stepperLimitInit(&axis_x);
+	stepperEngineInit(axes, 2);
+
+	test_blend_through();
+	test_blend_slower();
+	test_reversal(100, STEPPER_START_PPS);	// jerk / 2 is below start speed
+	test_reversal(600, 600 / 2);
+	test_limit_direction();
+
+	if(failed){
+		printf("%u checks failed\n", failed);
+		return 1;
+	}
+	printf("all tests passed\n");
+	return 0;
+}
@@ -12,6 +12,11 @@
 #define D2 GPIO_Pin_8	//GPIOC, P89 - BLUE
 #define B1 GPIO_Pin_0	//GPIOA, PA0
 
+// events from interrupt routines
+#define EVENT_UART_RX	0
+
+void uart_rx_handler(const event_t* event);
+
 void GPIO_Setup( void )
 {
 	//STM32F030 discovery onboard leds and button
@@ -24,9 +29,11 @@ void GPIO_Setup( void )
 int main(void)
 {	
 	RCC_ClocksTypeDef RCC_Clocks;
+	uint32_t print_time = 0;
 	
 	GPIO_Setup();
 	systick_millis_init();
+	event_register(EVENT_UART_RX, uart_rx_handler);
 	UART_Init();	// PA9, PA10
 	
 	printLn();
@@ -42,20 +49,26 @@ int main(void)
 	
 	
 	while(1){  
-		gpio_toggleBit(GPIOC, D1);
-		printNumberLn(millis()/1000, DEC); 
-		delay(500);
+		event_dispatch();
+		if((millis() - print_time) >= 500){
+			print_time = millis();
+			gpio_toggleBit(GPIOC, D1);
+			printNumberLn(millis()/1000, DEC); 
+		}
   }
 }
 
+// received character: called from main loop (event_dispatch()), printing doesn't block interrupt routine
+void uart_rx_handler(const event_t* event)
+{
+	if(event->data == 'x'){			
+		printStringLn("uart event");    
+	} 
+}
+
 void USART1_IRQHandler(){
-	while(USART_GetITStatus(USART1, USART_IT_RXNE) != RESET){			// Received characters added to fifo
-		USART_ClearITPendingBit(USART1, USART_IT_RXNE);
-		
-		// Receive the character
-		if(USART_ReceiveData(USART1) == 'x'){			
-			printStringLn("uart in interrupt");    
-		} 
+	while(reg_usartRxReady(USART1)){			// Received characters added to event queue
+		event_post(EVENT_UART_RX, reg_usartReceive(USART1));
 	}
 }
 
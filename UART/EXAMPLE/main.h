@@ -9,6 +9,7 @@
 #include <stm32f0xx_gpio_init.h>
 #include <systick_millis.h>
 #include <stm32f030xx_uart_print.h>
+#include <stm32f0xx_event.h>
 
 
 #endif /* __MAIN_H */
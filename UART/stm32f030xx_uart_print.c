@@ -21,7 +21,7 @@ RX:     |PA3(!)	PA10	PB7		PA15(!)	|PA3		PA15(!) |RX
 
 (!) - check package and model for availability...
 
-BAUD RATE: 9600, 19200, 38400, 57600, 115200 ... check docs.
+BAUD RATE: UART_BAUDRATE
 */
 void UART_Init(void){
 	USART_InitTypeDef USART_InitStructure;	
@@ -39,7 +39,7 @@ void UART_Init(void){
 					gpio_pinSetup_AF(GPIOA, GPIO_Pin_10, GPIO_AF_1, GPIO_OType_PP, GPIO_PuPd_UP, GPIO_Speed_50MHz);
 					RCC_AHBPeriphClockCmd(RCC_AHBPeriph_GPIOA, ENABLE);
 
-					USART_InitStructure.USART_BaudRate = 19200;
+					USART_InitStructure.USART_BaudRate = UART_BAUDRATE;
 	
 	USART_InitStructure.USART_WordLength = USART_WordLength_8b;
 	USART_InitStructure.USART_StopBits = USART_StopBits_1;
@@ -75,20 +75,34 @@ void UART_Init(void){
 				//USART_Cmd(USART3, ENABLE);
 }
 
+/*
+	System clock changed: BRR can be written only when USART is disabled. Oversampling by 16.
+	USART1 clock: PCLK (default), USART2: PCLK.
+*/
+void UART_ClockUpdate(const RCC_ClocksTypeDef* clocks){
+	USART1->CR1 &= ~USART_CR1_UE;
+	USART1->BRR = (clocks->USART1CLK_Frequency + (UART_BAUDRATE / 2)) / UART_BAUDRATE;
+	USART1->CR1 |= USART_CR1_UE;
+	
+	/*USART2->CR1 &= ~USART_CR1_UE;
+	USART2->BRR = (clocks->USART2CLK_Frequency + (UART_BAUDRATE / 2)) / UART_BAUDRATE;
+	USART2->CR1 |= USART_CR1_UE;*/
+}
+
 /*
 	Modify this functions according to your hardware send protocol apd peripheral
 */
 uint32_t _send_byte(uint8_t byte){
-	while(USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET);	//wait for cleared flag
-	USART_SendData(USART1, byte);	
+	while(reg_usartTxReady(USART1) == 0);	//wait for empty transmit data register
+	reg_usartSend(USART1, byte);	
 	return 0;
 	
-	/*while(USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET);	//wait for cleared flag
-	USART_SendData(USART2, byte);	
+	/*while(reg_usartTxReady(USART2) == 0);	//wait for empty transmit data register
+	reg_usartSend(USART2, byte);	
 	return 0;*/
 	
-	/*while(USART_GetFlagStatus(USART3, USART_FLAG_TXE) == RESET);	//wait for cleared flag
-	USART_SendData(USART3, byte);	
+	/*while(reg_usartTxReady(USART3) == 0);	//wait for empty transmit data register
+	reg_usartSend(USART3, byte);	
 	return 0;*/
 }
 
@@ -31,6 +31,7 @@
 #include <math.h>
 
 #include "stm32f0xx_gpio_init.h"
+#include "stm32f0xx_reg.h"
  
 //uint8_t base:
 #define	DEC	10
@@ -38,11 +39,16 @@
 #define HEX 16
 #define OCT 8
 
+#define UART_BAUDRATE	19200	// 9600, 19200, 38400, 57600, 115200 ... check docs.
+
 /****************************************************************************************/
 /* COMMUNICATION FUNCTIONS - change in .c file accordingly to your HW */
 /****************************************************************************************/
 // initialize UART
 void UART_Init(void);
+
+// system clock changed: recalculate baud rate register (register with clock_register())
+void UART_ClockUpdate(const RCC_ClocksTypeDef* clocks);
 /*
 If RX interrupt is used, call 
 void USARTx_IRQHandler(){